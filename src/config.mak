@@ -2,11 +2,15 @@ PREFIX = /usr/local
 prefix = $(DESTDIR)$(PREFIX)
 
 #CFLAGS += -DDEBUG
+#CFLAGS += -DUSDT # static probes for perf and bpftrace, needs <sys/sdt.h>
 
 CFLAGS += -Os -fomit-frame-pointer -g -Wall
 
 CFLAGS += -D_LARGEFILE_SOURCE -D_FILE_OFFSET_BITS=64
 
+CFLAGS += -pthread
+LDFLAGS += -pthread
+
 CC = cc
 RANLIB  = ranlib
 AR = ar
@@ -0,0 +1,145 @@
+// (C) 2026 agent
+// This file is available under the MIT/X license, see COPYING
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_CLMUL 1
+#include <immintrin.h>
+#endif
+#include "libnut.h"
+#include "priv.h"
+
+// CRC-32 with polynomial 0x04C11DB7, MSB first, initial value 0 and no
+// final xor. Appending the result big-endian makes the CRC of the whole
+// buffer 0, which is how every checksum in NUT is verified.
+
+#define POLY 0x04C11DB7
+
+static uint32_t slice_table[8][256];
+static uint32_t (*crc32_func)(const uint8_t * buf, int len);
+static pthread_once_t crc32_once = PTHREAD_ONCE_INIT;
+
+uint32_t nut_crc32_nibble(const uint8_t * buf, int len) {
+	static const uint32_t table[16] = {
+		0x00000000, 0x04C11DB7, 0x09823B6E, 0x0D4326D9,
+		0x130476DC, 0x17C56B6B, 0x1A864DB2, 0x1E475005,
+		0x2608EDB8, 0x22C9F00F, 0x2F8AD6D6, 0x2B4BCB61,
+		0x350C9B64, 0x31CD86D3, 0x3C8EA00A, 0x384FBDBD,
+	};
+	uint32_t crc = 0;
+	while (len--) {
+		crc ^= (uint32_t)*buf++ << 24;
+		crc = (crc<<4) ^ table[crc>>28];
+		crc = (crc<<4) ^ table[crc>>28];
+	}
+	return crc;
+}
+
+static uint32_t slice8_update(uint32_t crc, const uint8_t * buf, int len) {
+	const uint32_t (*t)[256] = (const uint32_t (*)[256])slice_table;
+	for (; len >= 8; buf += 8, len -= 8) {
+		uint32_t a = crc ^ ((uint32_t)buf[0] << 24 | buf[1] << 16 | buf[2] << 8 | buf[3]);
+		crc = t[7][a >> 24] ^ t[6][(a >> 16) & 0xFF] ^ t[5][(a >> 8) & 0xFF] ^ t[4][a & 0xFF]
+		    ^ t[3][buf[4]] ^ t[2][buf[5]] ^ t[1][buf[6]] ^ t[0][buf[7]];
+	}
+	while (len--) crc = (crc << 8) ^ t[0][(crc >> 24) ^ *buf++];
+	return crc;
+}
+
+static uint32_t crc32_slice8(const uint8_t * buf, int len) {
+	return slice8_update(0, buf, len);
+}
+
+#ifdef HAVE_CLMUL
+static uint64_t k_fold16[2], k_fold64[2]; // x^(n+64) and x^n mod P, for n = 128 and 512 bits
+
+static uint32_t xpow_mod(int n) { // x^n mod P
+	uint32_t r = 1;
+	while (n--) r = (r << 1) ^ (r & 0x80000000 ? POLY : 0);
+	return r;
+}
+
+__attribute__((target("pclmul,ssse3")))
+static __m128i fold(__m128i x, __m128i k, __m128i next) {
+	__m128i hi = _mm_clmulepi64_si128(x, k, 0x11);
+	__m128i lo = _mm_clmulepi64_si128(x, k, 0x00);
+	return _mm_xor_si128(_mm_xor_si128(hi, lo), next);
+}
+
+__attribute__((target("pclmul,ssse3")))
+static uint32_t crc32_clmul(const uint8_t * buf, int len) {
+	// 128 bit blocks are byte swapped so bit n is the coefficient of x^n
+	const __m128i swap = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+	const __m128i k16 = _mm_set_epi64x(k_fold16[0], k_fold16[1]);
+	const __m128i k64 = _mm_set_epi64x(k_fold64[0], k_fold64[1]);
+	__m128i x0, x1, x2, x3;
+	uint8_t rest[16];
+
+	if (len < 128) return slice8_update(0, buf, len);
+
+	x0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)buf), swap);
+	x1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(buf + 16)), swap);
+	x2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(buf + 32)), swap);
+	x3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(buf + 48)), swap);
+	buf += 64; len -= 64;
+	for (; len >= 64; buf += 64, len -= 64) {
+		x0 = fold(x0, k64, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)buf), swap));
+		x1 = fold(x1, k64, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(buf + 16)), swap));
+		x2 = fold(x2, k64, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(buf + 32)), swap));
+		x3 = fold(x3, k64, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(buf + 48)), swap));
+	}
+	x0 = fold(x0, k16, x1);
+	x0 = fold(x0, k16, x2);
+	x0 = fold(x0, k16, x3);
+	for (; len >= 16; buf += 16, len -= 16) {
+		x0 = fold(x0, k16, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)buf), swap));
+	}
+
+	// x0 is now congruent to everything before buf, and the CRC is linear
+	_mm_storeu_si128((__m128i *)rest, _mm_shuffle_epi8(x0, swap));
+	return slice8_update(slice8_update(0, rest, 16), buf, len);
+}
+#endif
+
+static void crc32_init(void) {
+	int i, j;
+	for (i = 0; i < 256; i++) {
+		uint32_t crc = (uint32_t)i << 24;
+		for (j = 0; j < 8; j++) crc = (crc << 1) ^ (crc & 0x80000000 ? POLY : 0);
+		slice_table[0][i] = crc;
+	}
+	for (i = 0; i < 256; i++) for (j = 1; j < 8; j++) {
+		uint32_t crc = slice_table[j - 1][i];
+		slice_table[j][i] = (crc << 8) ^ slice_table[0][crc >> 24];
+	}
+	crc32_func = crc32_slice8;
+#ifdef HAVE_CLMUL
+	k_fold16[0] = xpow_mod(128 + 64);
+	k_fold16[1] = xpow_mod(128);
+	k_fold64[0] = xpow_mod(512 + 64);
+	k_fold64[1] = xpow_mod(512);
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3")) crc32_func = crc32_clmul;
+#endif
+}
+
+uint32_t nut_crc32(const uint8_t * buf, int len) {
+	pthread_once(&crc32_once, crc32_init);
+	return crc32_func(buf, len);
+}
+
+uint32_t nut_crc32_slice8(const uint8_t * buf, int len) {
+	pthread_once(&crc32_once, crc32_init);
+	return crc32_slice8(buf, len);
+}
+
+uint32_t nut_crc32_clmul(const uint8_t * buf, int len) {
+	pthread_once(&crc32_once, crc32_init);
+#ifdef HAVE_CLMUL
+	if (crc32_func == crc32_clmul) return crc32_clmul(buf, len);
+#endif
+	return crc32_slice8(buf, len); // not supported by this CPU
+}
@@ -4,9 +4,36 @@
 #include <inttypes.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 #include "libnut.h"
 #include "priv.h"
 
+struct shared_headers_s {
+	pthread_mutex_t lock;
+	int refs;                 // contexts using it, the last nut_demuxer_uninit() frees it
+	nut_alloc_tt alloc;       // of the context which read the headers
+	int timebase_count;
+	nut_timebase_tt * tb;
+	int stream_count;
+	stream_context_tt * sc;   // only sh and the coding parameters are used
+	int info_count;
+	nut_info_packet_tt * info;
+	int max_distance;
+	frame_table_tt ft[256];
+	off_t last_headers;
+	syncpoint_list_tt syncpoints; // never changed, with valid bounds. Playback starts at s[0]
+};
+
 static size_t stream_read(void * priv, size_t len, uint8_t * buf) {
 	return fread(buf, 1, len, priv);
 }
@@ -16,28 +43,59 @@ static off_t stream_seek(void * priv, long long pos, int whence) {
 	return ftello(priv);
 }
 
+static void stream_hint(void * priv, off_t pos, size_t len) {
+	posix_fadvise(fileno(priv), pos, len, POSIX_FADV_WILLNEED);
+}
+
 static void flush_buf(input_buffer_tt *bc) {
 	assert(!bc->is_mem);
 	bc->file_pos += bc->buf_ptr - bc->buf;
 	bc->read_len -= bc->buf_ptr - bc->buf;
-	memmove(bc->buf, bc->buf_ptr, bc->read_len);
-	bc->buf_ptr = bc->buf;
+	bc->buf = bc->buf_ptr; // just slide the window, ready_read_buf() compacts when it needs room
 }
 
 static int ready_read_buf(input_buffer_tt * bc, int amount) {
 	int pos = (bc->buf_ptr - bc->buf);
+	if (bc->map) {
+		// same window size as a real read would give, but no copying
+		off_t left = bc->map + bc->map_len - bc->buf;
+		if (bc->read_len - pos < amount) {
+			int len = MIN(pos + amount + 10, MAX(left, 0));
+			if (bc->trace && len > bc->read_len) bc->trace->bytes_read += len - bc->read_len;
+			bc->read_len = len;
+		}
+		return bc->read_len - pos;
+	}
 	if (bc->read_len - pos < amount && !bc->is_mem) {
-		amount += 10;
+		int start = bc->buf - bc->base; // flushed data still in front of the window
+		int want = amount + 10 - (bc->read_len - pos);
 		if (!bc->alloc) return 0; // there was a previous memory error
-		if (bc->write_len - pos < amount) {
-			int new_len = amount + pos + PREALLOC_SIZE;
-			uint8_t * buf = bc->alloc->realloc(bc->buf, new_len);
+		if (want < bc->read_ahead) want = bc->read_ahead;
+		if (bc->read_ahead_align) {
+			off_t end = bc->file_pos + bc->read_len + want;
+			want += (bc->read_ahead_align - end % bc->read_ahead_align) % bc->read_ahead_align;
+		}
+		if (bc->write_len - start < bc->read_len + want && start >= bc->read_len) {
+			// moves no more than what was flushed since the last time, so amortized O(1) per byte
+			memmove(bc->base, bc->buf, bc->read_len);
+			bc->buf = bc->base;
+			bc->buf_ptr = bc->buf + pos;
+			start = 0;
+		}
+		if (bc->write_len - start < bc->read_len + want) {
+			int new_len = start + bc->read_len + want + PREALLOC_SIZE;
+			uint8_t * buf = bc->alloc->realloc(bc->base, new_len);
 			if (!buf) { bc->alloc = NULL; return 0; }
+			probe(buffer_grow, bc->write_len, new_len);
 			bc->write_len = new_len;
-			bc->buf = buf;
+			bc->base = buf;
+			bc->buf = bc->base + start;
 			bc->buf_ptr = bc->buf + pos;
 		}
-		bc->read_len += bc->isc.read(bc->isc.priv, amount - (bc->read_len - pos), bc->buf + bc->read_len);
+		want = bc->isc.read(bc->isc.priv, want, bc->buf + bc->read_len);
+		if (bc->trace) bc->trace->bytes_read += want;
+		bc->read_len += want;
+		if (bc->read_ahead < bc->read_ahead_max) bc->read_ahead = MIN(bc->read_ahead * 2, bc->read_ahead_max);
 	}
 	return bc->read_len - (bc->buf_ptr - bc->buf);
 }
@@ -47,12 +105,29 @@ static void seek_buf(input_buffer_tt * bc, long long pos, int whence) {
 	if (whence != SEEK_END) {
 		// don't do anything when already in seeked position. but still flush_buf
 		off_t req = pos + (whence == SEEK_CUR ? bctello(bc) : 0);
+		if (!bc->map && req < bc->file_pos && req >= bc->file_pos - (bc->buf - bc->base)) {
+			// going back into flushed data that wasn't compacted away yet
+			bc->read_len += bc->buf - bc->base;
+			bc->file_pos -= bc->buf - bc->base;
+			bc->buf = bc->base;
+		}
 		if (req >= bc->file_pos && req <= bc->file_pos + bc->read_len) {
 			bc->buf_ptr = bc->buf + (req - bc->file_pos);
 			flush_buf(bc);
 			return;
 		}
 	}
+	if (bc->map) {
+		if (whence == SEEK_CUR) pos += bctello(bc);
+		if (whence == SEEK_END) {
+			bc->filesize = bc->map_len;
+			pos += bc->map_len;
+		}
+		bc->file_pos = MIN(MAX(pos, 0), bc->map_len);
+		bc->buf_ptr = bc->buf = bc->map + bc->file_pos;
+		bc->read_len = 0;
+		return;
+	}
 	if (whence == SEEK_CUR) pos -= bc->read_len - (bc->buf_ptr - bc->buf);
 	debug_msg("seeking %d ", (int)pos);
 	switch (whence) {
@@ -61,11 +136,31 @@ static void seek_buf(input_buffer_tt * bc, long long pos, int whence) {
 		case SEEK_END: debug_msg("SEEK_END   "); break;
 	}
 	bc->file_pos = bc->isc.seek(bc->isc.priv, pos, whence);
-	bc->buf_ptr = bc->buf;
+	if (bc->trace) bc->trace->seeks++;
+	bc->buf_ptr = bc->buf = bc->base;
 	bc->read_len = 0;
+	bc->read_ahead = bc->read_ahead_min; // not sequential anymore
 	if (whence == SEEK_END) bc->filesize = bc->file_pos - pos;
 }
 
+static void hint_buf(input_buffer_tt * bc, off_t pos, int len) {
+	if (pos < 0) { len += pos; pos = 0; }
+	if (len <= 0 || bc->is_mem) return;
+	if (pos >= bc->file_pos && pos + len <= bc->file_pos + bc->read_len) return; // already here
+	if (bc->map) {
+		off_t start = pos - pos % sysconf(_SC_PAGESIZE);
+		if (start < bc->map_len) madvise(bc->map + start, MIN(pos + len, bc->map_len) - start, MADV_WILLNEED);
+	} else if (bc->isc.hint) bc->isc.hint(bc->isc.priv, pos, len);
+}
+
+static void report_checksums(nut_context_tt * nut) {
+	off_t pos;
+	if (!nut->i->verify) return;
+	while (verify_failed(nut->i->verify, &pos)) {
+		if (nut->dopts.bad_checksum) nut->dopts.bad_checksum(nut->dopts.checksum_priv, pos);
+	}
+}
+
 static int buf_eof(input_buffer_tt * bc) {
 	if (bc->is_mem) return NUT_ERR_BAD_EOF;
 	if (!bc->alloc) return NUT_ERR_OUT_OF_MEM;
@@ -81,7 +176,7 @@ static int skip_buffer(input_buffer_tt * bc, int len) {
 
 static uint8_t * get_buf(input_buffer_tt * bc, off_t start) {
 	start -= bc->file_pos;
-	assert((unsigned)start < bc->read_len);
+	assert((unsigned)start <= bc->read_len); // the end is where a rewind before an EAGAIN can go
 	return bc->buf + start;
 }
 
@@ -92,8 +187,15 @@ static input_buffer_tt * new_mem_buffer(input_buffer_tt * bc) {
 	bc->is_mem = 1;
 	bc->file_pos = 0;
 	bc->filesize = 0;
-	bc->buf_ptr = bc->buf = NULL;
+	bc->buf_ptr = bc->buf = bc->base = NULL;
 	bc->alloc = NULL;
+	bc->map = NULL;
+	bc->map_len = 0;
+	bc->read_ahead = bc->read_ahead_min = bc->read_ahead_max = bc->read_ahead_align = 0;
+	bc->prefetch = NULL;
+	bc->checksums = NUT_CHECKSUM_STRICT;
+	bc->verify = NULL;
+	bc->trace = NULL;
 	return bc;
 }
 
@@ -108,19 +210,103 @@ static input_buffer_tt * new_input_buffer(nut_alloc_tt * alloc, nut_input_stream
 		bc->isc.read = stream_read;
 		bc->isc.seek = stream_seek;
 		bc->isc.eof = NULL;
+		bc->isc.hint = stream_hint;
 	}
 	return bc;
 }
 
+static void map_input_buffer(input_buffer_tt * bc) {
+	struct stat st;
+	void * map;
+	off_t pos;
+	if (bc->isc.read != stream_read) return; // only a FILE* can be mapped
+	if (fstat(fileno(bc->isc.priv), &st) || !S_ISREG(st.st_mode) || !st.st_size) return;
+	if ((size_t)st.st_size != st.st_size) return; // too big for the address space
+	if ((pos = ftello(bc->isc.priv)) < 0 || pos > st.st_size) return;
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fileno(bc->isc.priv), 0);
+	if (map == MAP_FAILED) return;
+	bc->map = map;
+	bc->map_len = st.st_size;
+	bc->filesize = st.st_size;
+	bc->buf_ptr = bc->buf = bc->map + pos;
+}
+
 static void free_buffer(input_buffer_tt * bc) {
 	if (!bc) return;
 	assert(!bc->is_mem);
-	bc->alloc->free(bc->buf);
+	verify_uninit(bc->verify); // may still be reading the mapped file
+	if (bc->map) munmap(bc->map, bc->map_len);
+	else bc->alloc->free(bc->base);
+	prefetch_uninit(bc->prefetch);
 	bc->alloc->free(bc);
 }
 
+static inline uint64_t read_be64(const uint8_t * p) {
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	uint64_t tmp;
+	memcpy(&tmp, p, 8);
+	return __builtin_bswap64(tmp);
+#else
+	uint64_t tmp = 0;
+	int i;
+	for (i = 0; i < 8; i++) tmp = (tmp << 8) | p[i];
+	return tmp;
+#endif
+}
+
+static int is_startcode(const uint8_t * p, uint64_t code1, uint64_t code2) {
+	uint64_t tmp = read_be64(p);
+	return tmp == code1 || tmp == code2;
+}
+
+/// Returns start of the first code1 or code2 entirely in [p, end), or NULL. Both must begin with 'N'.
+static uint8_t * find_startcode(uint8_t * p, uint8_t * end, uint64_t code1, uint64_t code2) {
+	uint8_t c1 = code1 >> 48, c2 = code2 >> 48; // what follows the 'N'
+	if (end - p < 8) return NULL;
+#ifdef __AVX2__
+	while (end - p > 32) {
+		__m256i n = _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i *)p), _mm256_set1_epi8('N'));
+		__m256i b = _mm256_loadu_si256((__m256i *)(p + 1));
+		__m256i c = _mm256_or_si256(_mm256_cmpeq_epi8(b, _mm256_set1_epi8(c1)), _mm256_cmpeq_epi8(b, _mm256_set1_epi8(c2)));
+		unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(n, c));
+		for (; mask; mask &= mask - 1) {
+			uint8_t * q = p + __builtin_ctz(mask);
+			if (end - q < 8) return NULL;
+			if (is_startcode(q, code1, code2)) return q;
+		}
+		p += 32;
+	}
+#endif
+#ifdef __SSE2__
+	while (end - p > 16) {
+		__m128i n = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i *)p), _mm_set1_epi8('N'));
+		__m128i b = _mm_loadu_si128((__m128i *)(p + 1));
+		__m128i c = _mm_or_si128(_mm_cmpeq_epi8(b, _mm_set1_epi8(c1)), _mm_cmpeq_epi8(b, _mm_set1_epi8(c2)));
+		unsigned mask = _mm_movemask_epi8(_mm_and_si128(n, c));
+		for (; mask; mask &= mask - 1) {
+			uint8_t * q = p + __builtin_ctz(mask);
+			if (end - q < 8) return NULL;
+			if (is_startcode(q, code1, code2)) return q;
+		}
+		p += 16;
+	}
+#endif
+	for (; end - p >= 8; p++) {
+		if (p[0] != 'N' || (p[1] != c1 && p[1] != c2)) continue;
+		if (is_startcode(p, code1, code2)) return p;
+	}
+	return NULL;
+}
+
+#define buf_left(bc) ((bc)->read_len - ((bc)->buf_ptr - (bc)->buf))
+
 static int get_bytes(input_buffer_tt * bc, int count, uint64_t * val) {
 	int i;
+	if (count && buf_left(bc) >= 8) {
+		*val = read_be64(bc->buf_ptr) >> (64 - count*8);
+		bc->buf_ptr += count;
+		return 0;
+	}
 	if (ready_read_buf(bc, count) < count) return buf_eof(bc);
 	*val = 0;
 	for (i = 0; i < count; i++) {
@@ -131,6 +317,23 @@ static int get_bytes(input_buffer_tt * bc, int count, uint64_t * val) {
 
 static int get_v(input_buffer_tt * bc, uint64_t * val) {
 	int i, len;
+#ifdef __GNUC__
+	if (buf_left(bc) >= 8) {
+		uint64_t tmp = read_be64(bc->buf_ptr);
+		uint64_t last = ~tmp & 0x8080808080808080ULL; // bytes without the continuation bit
+		if (last) {
+			len = __builtin_clzll(last) / 8 + 1;
+			tmp = (tmp >> (64 - len*8)) & 0x7F7F7F7F7F7F7F7FULL;
+			// pack the 7 bit groups together, 2 then 4 then 8 at a time
+			tmp = (tmp & 0x007F007F007F007FULL) | ((tmp & 0x7F007F007F007F00ULL) >> 1);
+			tmp = (tmp & 0x00003FFF00003FFFULL) | ((tmp & 0x3FFF00003FFF0000ULL) >> 2);
+			tmp = (tmp & 0x000000000FFFFFFFULL) | ((tmp & 0x0FFFFFFF00000000ULL) >> 4);
+			bc->buf_ptr += len;
+			*val = tmp;
+			return 0;
+		}
+	}
+#endif
 	*val = 0;
 
 	do {
@@ -221,6 +424,14 @@ static int get_vb(nut_alloc_tt * alloc, input_buffer_tt * in, int * len, uint8_t
 	return 0;
 }
 
+static int check_checksum(input_buffer_tt * in, off_t start, int len) {
+	switch (in->checksums) {
+		case NUT_CHECKSUM_TRUSTED: return 0;
+		case NUT_CHECKSUM_DEFERRED: return verify_queue(in->verify, get_buf(in, start), len, start, !in->map);
+	}
+	return nut_crc32(get_buf(in, start), len) ? NUT_ERR_BAD_CHECKSUM : 0;
+}
+
 static int get_header(input_buffer_tt * in, input_buffer_tt * out) {
 	off_t start = bctello(in) - 8; // startcode
 	int forward_ptr;
@@ -229,12 +440,13 @@ static int get_header(input_buffer_tt * in, input_buffer_tt * out) {
 	GET_V(in, forward_ptr);
 	if (forward_ptr > 4096) {
 		CHECK(skip_buffer(in, 4)); // header_checksum
-		ERROR(crc32(get_buf(in, start), bctello(in) - start), NUT_ERR_BAD_CHECKSUM);
+		// always checked, a bad forward_ptr would skip or allocate nonsense
+		ERROR(nut_crc32(get_buf(in, start), bctello(in) - start), NUT_ERR_BAD_CHECKSUM);
 	}
 	start = bctello(in);
 
 	CHECK(skip_buffer(in, forward_ptr));
-	ERROR(crc32(get_buf(in, start), forward_ptr), NUT_ERR_BAD_CHECKSUM);
+	CHECK(check_checksum(in, start, forward_ptr));
 
 	if (out) {
 		assert(out->is_mem);
@@ -246,6 +458,15 @@ err_out:
 	return err;
 }
 
+static int get_header_strict(input_buffer_tt * in, input_buffer_tt * out) {
+	// for telling real headers from startcode emulation, whatever the policy
+	int checksums = in->checksums, err;
+	in->checksums = NUT_CHECKSUM_STRICT;
+	err = get_header(in, out);
+	in->checksums = checksums;
+	return err;
+}
+
 static int get_main_header(nut_context_tt * nut) {
 	input_buffer_tt itmp, * tmp = new_mem_buffer(&itmp);
 	int i, j, err = 0;
@@ -261,9 +482,11 @@ static int get_main_header(nut_context_tt * nut) {
 
 	GET_V(tmp, nut->timebase_count);
 	nut->alloc->free(nut->tb); nut->tb = NULL;
+	nut->alloc->free(nut->seek_pts); nut->seek_pts = NULL;
 	ERROR(SIZE_MAX/sizeof(nut_timebase_tt) < nut->timebase_count, NUT_ERR_OUT_OF_MEM);
 	nut->tb = nut->alloc->malloc(nut->timebase_count * sizeof(nut_timebase_tt));
 	ERROR(!nut->tb, NUT_ERR_OUT_OF_MEM);
+	SAFE_CALLOC(nut->alloc, nut->seek_pts, sizeof(uint64_t), nut->timebase_count);
 	for (i = 0; i < nut->timebase_count; i++) {
 		GET_V(tmp, nut->tb[i].num);
 		GET_V(tmp, nut->tb[i].den);
@@ -299,6 +522,12 @@ static int get_main_header(nut_context_tt * nut) {
 			nut->ft[i].reserved = reserved;
 		}
 	}
+
+	for (i = 0; i < 256; i++) {
+		frame_table_tt * ft = &nut->ft[i];
+		int coded = FLAG_INVALID | FLAG_CODED | FLAG_STREAM_ID | FLAG_CODED_PTS | FLAG_SIZE_MSB | FLAG_RESERVED | FLAG_CHECKSUM;
+		ft->simple = !(ft->flags & coded) && !ft->reserved && ft->stream < nut->stream_count;
+	}
 err_out:
 	return err;
 }
@@ -347,10 +576,10 @@ err_out:
 	return err;
 }
 
-static void free_info_packet(nut_context_tt * nut, nut_info_packet_tt * info) {
+static void free_info_packet(nut_alloc_tt * alloc, nut_info_packet_tt * info) {
 	int i;
-	for (i = 0; i < info->count; i++) nut->alloc->free(info->fields[i].data);
-	nut->alloc->free(info->fields);
+	for (i = 0; i < info->count; i++) alloc->free(info->fields[i].data);
+	alloc->free(info->fields);
 }
 
 static int get_info_header(nut_context_tt * nut, nut_info_packet_tt * info) {
@@ -371,9 +600,10 @@ static int get_info_header(nut_context_tt * nut, nut_info_packet_tt * info) {
 	for (i = 0; i < info->count; i++) {
 		int len;
 		nut_info_field_tt * field = &info->fields[i];
+		uint8_t * name = (uint8_t *)field->name, * type = (uint8_t *)field->type; // get_vb() fills arrays through a pointer
 
 		len = sizeof(field->name) - 1;
-		CHECK(get_vb(nut->alloc, tmp, &len, (uint8_t**)&field->name));
+		CHECK(get_vb(nut->alloc, tmp, &len, &name));
 		field->name[len] = 0;
 
 		GET_S(tmp, field->val);
@@ -384,7 +614,7 @@ static int get_info_header(nut_context_tt * nut, nut_info_packet_tt * info) {
 			field->val = field->den;
 		} else if (field->val == -2) {
 			len = sizeof(field->type) - 1;
-			CHECK(get_vb(nut->alloc, tmp, &len, (uint8_t**)&field->type));
+			CHECK(get_vb(nut->alloc, tmp, &len, &type));
 			field->type[len] = 0;
 			CHECK(get_vb(nut->alloc, tmp, &field->den, &field->data));
 			field->val = field->den;
@@ -409,72 +639,196 @@ err_out:
 	return err;
 }
 
-static void add_existing_syncpoint(nut_context_tt * nut, syncpoint_tt sp, uint64_t * pts, uint64_t * eor, int i) {
+static int syncpoint_index(const syncpoint_tt * s, int len, off_t pos) {
+	// index of the last syncpoint at or before pos, -1 if there is none
+	int lo = 0, hi = len;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (s[mid].pos <= pos) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo - 1;
+}
+
+static void free_syncpoints(nut_alloc_tt * alloc, syncpoint_list_tt * sl, int stream_count) {
+	int i;
+	for (i = 0; sl->eor && i < stream_count; i++) {
+		alloc->free(sl->keys[i].e);
+		alloc->free(sl->eor[i].e);
+	}
+	for (i = 0; sl->bounds && i < stream_count; i++) {
+		alloc->free(sl->bounds[i].key_hi);
+		alloc->free(sl->bounds[i].key_lo);
+		alloc->free(sl->bounds[i].eor_lo);
+	}
+	alloc->free(sl->bounds);
+	alloc->free(sl->s);
+	alloc->free(sl->keys);
+	alloc->free(sl->eor);
+}
+
+static int unshare_syncpoints(nut_context_tt * nut) {
+	// copy on write, the syncpoints of nut->shared never change.
+	// The bounds are not copied, the next seek builds them again.
+	syncpoint_list_tt * sl = &nut->syncpoints, l = { 0 };
+	int i, n = nut->stream_count, err = 0;
+	if (!sl->shared) return 0;
+	SAFE_CALLOC(nut->alloc, l.s, sizeof(syncpoint_tt), sl->len);
+	memcpy(l.s, sl->s, sl->len * sizeof(syncpoint_tt));
+	SAFE_CALLOC(nut->alloc, l.keys, sizeof(sparse_list_tt), n);
+	SAFE_CALLOC(nut->alloc, l.eor, sizeof(sparse_list_tt), n);
+	for (i = 0; i < n * 2; i++) {
+		sparse_list_tt * from = i < n ? &sl->keys[i] : &sl->eor[i - n];
+		sparse_list_tt * to = i < n ? &l.keys[i] : &l.eor[i - n];
+		if (!from->len) continue;
+		SAFE_CALLOC(nut->alloc, to->e, sizeof(sparse_pts_tt), from->len);
+		memcpy(to->e, from->e, from->len * sizeof(sparse_pts_tt));
+		to->len = to->alloc_len = from->len;
+	}
+	sl->s = l.s;
+	sl->alloc_len = sl->len;
+	sl->keys = l.keys;
+	sl->eor = l.eor;
+	sl->bounds = NULL;
+	sl->bounds_valid = 0;
+	sl->bounds_bytes = 0;
+	sl->shared = 0;
+	return 0;
+err_out:
+	free_syncpoints(nut->alloc, &l, n);
+	return err;
+}
+
+static int sparse_grow(nut_context_tt * nut, sparse_list_tt * l, int n) {
+	int alloc_len, err = 0;
+	if (l->len + n <= l->alloc_len) return 0;
+	alloc_len = MAX(l->len + n, l->alloc_len * 2);
+	SAFE_REALLOC(nut->alloc, l->e, sizeof(sparse_pts_tt), alloc_len);
+	l->alloc_len = alloc_len;
+err_out:
+	return err;
+}
+
+static int sparse_set(nut_context_tt * nut, sparse_list_tt * l, int sp, uint64_t pts) {
+	int i = sparse_find(l, sp), err = 0;
+	if (i < l->len && l->e[i].sp == sp) {
+		if (l->e[i].pts == pts) return 0;
+		if (pts) l->e[i].pts = pts;
+		else memmove(l->e + i, l->e + i + 1, (--l->len - i) * sizeof(sparse_pts_tt));
+		nut->syncpoints.bounds_valid = 0;
+		return 0;
+	}
+	if (!pts) return 0;
+	CHECK(sparse_grow(nut, l, 1));
+	nut->syncpoints.bounds_valid = 0;
+	memmove(l->e + i + 1, l->e + i, (l->len++ - i) * sizeof(sparse_pts_tt));
+	l->e[i].sp = sp;
+	l->e[i].pts = pts;
+err_out:
+	return err;
+}
+
+static int set_syncpoint_pts(nut_context_tt * nut, int i, uint64_t * pts, uint64_t * eor) {
+	syncpoint_list_tt * sl = &nut->syncpoints;
+	int j, err = 0;
+	for (j = 0; j < nut->stream_count; j++) {
+		CHECK(sparse_set(nut, &sl->keys[j], i, pts[j]));
+		CHECK(sparse_set(nut, &sl->eor[j], i, eor[j]));
+	}
+err_out:
+	return err;
+}
+
+static void shift_syncpoints(nut_context_tt * nut, int from, int delta) {
+	// syncpoints from 'from' to the end move by delta, those moved over are dropped
 	syncpoint_list_tt * sl = &nut->syncpoints;
 	int j;
+	memmove(sl->s + from + delta, sl->s + from, (sl->len - from) * sizeof(syncpoint_tt));
+	for (j = 0; j < nut->stream_count; j++) {
+		sparse_shift(&sl->keys[j], from, delta);
+		sparse_shift(&sl->eor[j], from, delta);
+	}
+	sl->len += delta;
+	if (delta < 0) sl->bounds_valid = 0; // otherwise only sp changed, bounds go by entry
+}
+
+static int grow_syncpoints(nut_context_tt * nut, int n) {
+	syncpoint_list_tt * sl = &nut->syncpoints;
+	int alloc_len, err = 0;
+	if (!n) return 0;
+	CHECK(unshare_syncpoints(nut)); // every caller changes the list next
+	if (sl->len + n <= sl->alloc_len) return 0;
+	// grow geometrically, filling the cache must not be quadratic
+	alloc_len = MAX(sl->len + n, sl->alloc_len + MAX(sl->alloc_len / 2, PREALLOC_SIZE/4));
+	SAFE_REALLOC(nut->alloc, sl->s, sizeof(syncpoint_tt), alloc_len);
+	sl->alloc_len = alloc_len;
+err_out:
+	return err;
+}
+
+static int add_existing_syncpoint(nut_context_tt * nut, syncpoint_tt sp, uint64_t * pts, uint64_t * eor, int i) {
+	syncpoint_list_tt * sl = &nut->syncpoints;
+	int j, err = 0;
 	int pts_cache = nut->dopts.cache_syncpoints & 1;
 
 	assert(sl->s[i].pos <= sp.pos && sp.pos < sl->s[i].pos + 16); // code sanity
 
 	assert(!sl->s[i].pts || sl->s[i].pts == sp.pts);
 	assert(!sl->s[i].back_ptr || sl->s[i].back_ptr == sp.back_ptr);
+	if (sl->shared) { // only copied for what seeking uses, pts and back_ptr of index entries can stay unknown
+		if (sl->s[i].merged || !sp.pts_valid) return 0;
+		if ((sl->s[i].pts_valid || !pts_cache) && (!i || sl->s[i-1].seen_next)) return 0;
+		CHECK(unshare_syncpoints(nut));
+	}
 	sl->s[i].pos = sp.pos;
 	sl->s[i].pts = sp.pts;
 	sl->s[i].back_ptr = sp.back_ptr;
+	sl->s[i].pts_unknown = 0;
+	if (sl->s[i].merged || sl->s[i].inside) return 0; // s[i-1] is not the syncpoint before it
 	if (pts_cache && sp.pts_valid) {
 		for (j = 0; j < nut->stream_count; j++) {
-			assert(!sl->s[i].pts_valid || sl->pts[i * nut->stream_count + j] == pts[j]);
-			assert(!sl->s[i].pts_valid || sl->eor[i * nut->stream_count + j] == eor[j]);
-			sl->pts[i * nut->stream_count + j] = pts[j];
-			sl->eor[i * nut->stream_count + j] = eor[j];
+			assert(!sl->s[i].pts_valid || sparse_get(&sl->keys[j], i) == pts[j]);
+			assert(!sl->s[i].pts_valid || sparse_get(&sl->eor[j], i) == eor[j]);
 		}
+		CHECK(set_syncpoint_pts(nut, i, pts, eor));
 		sl->s[i].pts_valid = 1;
 	}
 	if (sp.pts_valid && i) sl->s[i-1].seen_next = 1;
+err_out:
+	return err;
 }
 
 static int add_syncpoint(nut_context_tt * nut, syncpoint_tt sp, uint64_t * pts, uint64_t * eor, int * out) {
 	syncpoint_list_tt * sl = &nut->syncpoints;
-	int i, j, err = 0;
+	int i, err = 0;
 	int pts_cache = nut->dopts.cache_syncpoints & 1;
 
 	if (pts_cache && sp.pts_valid) assert(pts && eor); // code sanity check
 
-	for (i = sl->len; i--; ) { // more often than not, we're adding at end of list
-		if (sl->s[i].pos > sp.pos) continue;
-		if (sp.pos < sl->s[i].pos + 16) { // syncpoint already in list
-			add_existing_syncpoint(nut, sp, pts, eor, i);
-			if (out) *out = i;
-			return 0;
-		}
-		break;
+	i = syncpoint_index(sl->s, sl->len, sp.pos);
+	if (i >= 0 && sp.pos < sl->s[i].pos + 16) { // syncpoint already in list
+		if (out) *out = i;
+		return add_existing_syncpoint(nut, sp, pts, eor, i);
 	}
 	i++;
-	if (sl->len + 1 > sl->alloc_len) {
-		sl->alloc_len += PREALLOC_SIZE/4;
-		SAFE_REALLOC(nut->alloc, sl->s, sizeof(syncpoint_tt), sl->alloc_len);
-		if (pts_cache) {
-			SAFE_REALLOC(nut->alloc, sl->pts, nut->stream_count * sizeof(uint64_t), sl->alloc_len);
-			SAFE_REALLOC(nut->alloc, sl->eor, nut->stream_count * sizeof(uint64_t), sl->alloc_len);
-		}
-	}
-	memmove(sl->s + i + 1, sl->s + i, (sl->len - i) * sizeof(syncpoint_tt));
+	if (i < sl->len && (sl->s[i].merged || sl->s[i].inside)) {
+		// inside a region merged by thin_syncpoints(), which already covers
+		// this syncpoint. Only a seek needs it, until it is done.
+		if (!(nut->dopts.cache_syncpoints & 2)) return 0;
+		sp.pts_valid = 0;
+		sp.inside = 1;
+		sl->inside++;
+	}
+	CHECK(grow_syncpoints(nut, 1));
+	shift_syncpoints(nut, i, 1);
 	sl->s[i] = sp;
 	if (sl->s[i].pts_valid) {
 		if (!pts_cache) sl->s[i].pts_valid = 0; // pts_valid is not really true, only used for seen_next
 		if (i) sl->s[i-1].seen_next = 1;
 	}
 
-	if (pts_cache) {
-		memmove(sl->pts + (i + 1) * nut->stream_count, sl->pts + i * nut->stream_count, (sl->len - i) * nut->stream_count * sizeof(uint64_t));
-		memmove(sl->eor + (i + 1) * nut->stream_count, sl->eor + i * nut->stream_count, (sl->len - i) * nut->stream_count * sizeof(uint64_t));
-		for (j = 0; j < nut->stream_count; j++) {
-			sl->pts[i * nut->stream_count + j] = sl->s[i].pts_valid ? pts[j] : 0;
-			sl->eor[i * nut->stream_count + j] = sl->s[i].pts_valid ? eor[j] : 0;
-		}
-	}
+	if (pts_cache && sl->s[i].pts_valid) CHECK(set_syncpoint_pts(nut, i, pts, eor));
 
-	sl->len++;
 	if (out) *out = i;
 err_out:
 	return err;
@@ -486,19 +840,13 @@ static int queue_add_syncpoint(nut_context_tt * nut, syncpoint_tt sp, uint64_t *
 	size_t malloc_size;
 	int pts_cache = nut->dopts.cache_syncpoints & 1;
 	int err = 0;
-	int i = sl->cached_pos;
-
-	if (i >= sl->len) i = sl->len - 1;
+	int i = syncpoint_index(sl->s, sl->len, sp.pos);
 
-	while (sl->s[i].pos > sp.pos && i) i--;
-	while (sl->s[i+1].pos <= sp.pos && i < sl->len-1) i++;
-	// Result: sl->s[i].pos <= sp.pos < sl->s[i+1].pos
-	sl->cached_pos = i;
-
-	if (sl->s[i].pos <= sp.pos && sp.pos < sl->s[i].pos + 16) { // syncpoint already in list
-		add_existing_syncpoint(nut, sp, pts, eor, i);
-		return 0;
+	if (i >= 0 && sp.pos < sl->s[i].pos + 16 && !sl->linked) { // syncpoint already in list
+		return add_existing_syncpoint(nut, sp, pts, eor, i);
 	}
+	// else queued even if known, the syncpoint before it may be one of the
+	// queued ones, which only gets seen_next once they are flushed together
 
 	malloc_size = sizeof(syncpoint_linked_tt) - sizeof(uint64_t);
 	if (pts_cache && sp.pts_valid) {
@@ -507,6 +855,7 @@ static int queue_add_syncpoint(nut_context_tt * nut, syncpoint_tt sp, uint64_t *
 	}
 
 	SAFE_CALLOC(nut->alloc, s, 1, malloc_size);
+	sl->linked_bytes += malloc_size;
 
 	s->s = sp;
 	if (pts_cache && sp.pts_valid) {
@@ -522,14 +871,212 @@ err_out:
 	return err;
 }
 
+static int cmp_queued_syncpoints(const void * a, const void * b) {
+	off_t pa = (*(syncpoint_linked_tt * const *)a)->s.pos;
+	off_t pb = (*(syncpoint_linked_tt * const *)b)->s.pos;
+	return (pa > pb) - (pa < pb);
+}
+
+static int count_queued_pts(syncpoint_linked_tt ** q, int n, int off) {
+	int k, m = 0;
+	for (k = 0; k < n; k++) if (q[k]->s.pts_valid && q[k]->pts_eor[off]) m++;
+	return m;
+}
+
+static void merge_queued_pts(sparse_list_tt * l, syncpoint_linked_tt ** q, const int * at, int n, int off) {
+	// q[k] was inserted as syncpoint at[k], and its value is pts_eor[off]
+	int i, j, k, c = 0, m = count_queued_pts(q, n, off);
+	for (i = 0; i < l->len; i++) { // renumber the old entries first
+		while (c < n && at[c] <= l->e[i].sp + c) c++;
+		l->e[i].sp += c;
+	}
+	i = l->len - 1;
+	j = l->len += m;
+	for (k = n - 1; m; k--) {
+		if (!q[k]->s.pts_valid || !q[k]->pts_eor[off]) continue;
+		while (i >= 0 && l->e[i].sp > at[k]) l->e[--j] = l->e[i--];
+		l->e[--j].sp = at[k];
+		l->e[j].pts = q[k]->pts_eor[off];
+		m--;
+	}
+}
+
 static int flush_syncpoint_queue(nut_context_tt * nut) {
 	syncpoint_list_tt * sl = &nut->syncpoints;
+	syncpoint_linked_tt * s, ** q = NULL;
+	int * at = NULL;
+	int pts_cache = nut->dopts.cache_syncpoints & 1;
+	int n = 0, fresh = 0, i, j, k, err = 0;
+
+	for (s = sl->linked; s; s = s->prev) n++;
+	if (!n) return 0;
+	SAFE_CALLOC(nut->alloc, q, sizeof(syncpoint_linked_tt *), n);
+	SAFE_CALLOC(nut->alloc, at, sizeof(int), n);
+	for (s = sl->linked, i = n; s; s = s->prev) q[--i] = s;
+	qsort(q, n, sizeof(syncpoint_linked_tt *), cmp_queued_syncpoints);
+
+	// new syncpoints go to the front of q, still sorted. The rest are
+	// already in the list or were queued twice, they are merged last.
+	for (k = 0; k < n; k++) {
+		off_t pos = q[k]->s.pos;
+		i = syncpoint_index(sl->s, sl->len, pos);
+		if (i >= 0 && pos < sl->s[i].pos + 16) continue;
+		if (i + 1 < sl->len && sl->s[i+1].merged) continue; // add_syncpoint() drops it
+		if (fresh && pos < q[fresh-1]->s.pos + 16) continue;
+		s = q[fresh];
+		q[fresh++] = q[k];
+		q[k] = s;
+	}
+
+	// allocate everything first, the merge itself cannot fail
+	CHECK(grow_syncpoints(nut, fresh));
+	if (pts_cache) for (j = 0; j < nut->stream_count; j++) {
+		CHECK(sparse_grow(nut, &sl->keys[j], count_queued_pts(q, fresh, j)));
+		CHECK(sparse_grow(nut, &sl->eor[j], count_queued_pts(q, fresh, j + nut->stream_count)));
+	}
+
+	// merge from the end, every old entry is moved at most once
+	i = sl->len - 1;
+	for (k = fresh - 1; k >= 0; k--) {
+		int first;
+		s = q[k];
+		first = syncpoint_index(sl->s, i + 1, s->s.pos) + 1; // old entries from first to i go after s
+		memmove(sl->s + first + k + 1, sl->s + first, (i + 1 - first) * sizeof(syncpoint_tt));
+		i = first - 1;
+		at[k] = j = i + k + 1;
+
+		sl->s[j] = s->s;
+		if (s->s.pts_valid) {
+			if (!pts_cache) sl->s[j].pts_valid = 0; // only used for seen_next
+			if (k && (i < 0 || q[k-1]->s.pos > sl->s[i].pos)) q[k-1]->s.seen_next = 1;
+			else if (i >= 0) sl->s[i].seen_next = 1;
+		}
+	}
+	sl->len += fresh;
+	if (pts_cache && fresh) for (j = 0; j < nut->stream_count; j++) {
+		merge_queued_pts(&sl->keys[j], q, at, fresh, j);
+		merge_queued_pts(&sl->eor[j], q, at, fresh, j + nut->stream_count);
+	}
+	if (pts_cache && fresh) sl->bounds_valid = 0;
+
+	for (k = fresh; k < n; k++) CHECK(add_syncpoint(nut, q[k]->s, q[k]->pts_eor, q[k]->pts_eor + nut->stream_count, NULL));
+
+	for (k = 0; k < n; k++) nut->alloc->free(q[k]);
+	sl->linked = NULL;
+	sl->linked_bytes = 0;
+err_out:
+	nut->alloc->free(q);
+	nut->alloc->free(at);
+	return err;
+}
+
+static void drop_inside_syncpoints(nut_context_tt * nut) {
+	// the merged regions around them are as they were before the seek
+	syncpoint_list_tt * sl = &nut->syncpoints;
+	int i, j;
+	for (i = sl->len - 1; sl->inside && i > 0; i--) {
+		if (!sl->s[i].inside) continue;
+		for (j = i; sl->s[j-1].inside; j--);
+		sl->s[j-1].seen_next = 0;
+		shift_syncpoints(nut, i + 1, j - i - 1);
+		sl->inside -= i - j + 1;
+		i = j;
+	}
+}
+
+static int thin_kept(int sp, int len) {
+	// the first and last two syncpoints stay, and every other one between them.
+	// The last region is never merged, seeks after its keyframes still find EOF.
+	return !(sp & 1) || sp >= len - 2;
+}
+
+static uint64_t sparse_next(const sparse_list_tt * l, int * r, int sp) {
+	// value at sp, for calls with increasing sp. *r is the read position.
+	while (*r < l->len && l->e[*r].sp < sp) (*r)++;
+	return *r < l->len && l->e[*r].sp == sp ? l->e[*r].pts : 0;
+}
+
+static void thin_sparse(nut_context_tt * nut, sparse_list_tt * l, const sparse_list_tt * keys, int len) {
+	// l is a keys list if keys is NULL, otherwise the eor list of that stream.
+	// A dropped syncpoint's region joins the next one's, and the values merge.
+	// Entries are never written past the read position, so l is rewritten in place.
+	const syncpoint_tt * s = nut->syncpoints.s;
+	int i, n = 0, j = 0, r = 0, rk = 0;
+	for (i = 0; i < len; i++) {
+		uint64_t v = 0;
+		if (!thin_kept(i, len)) continue;
+		if (i && !thin_kept(i - 1, len)) {
+			if (s[i-1].pts_valid && s[i].pts_valid) {
+				uint64_t prev = sparse_next(l, &r, i - 1);
+				v = sparse_next(l, &r, i);
+				if (!keys) { if (prev) v = prev; } // first keyframe of both
+				else if (!v && !sparse_next(keys, &rk, i)) v = prev; // nothing of the stream after its EOR
+			}
+		} else v = sparse_next(l, &r, i);
+		if (v) {
+			l->e[j].sp = n;
+			l->e[j++].pts = v;
+		}
+		n++;
+	}
+	l->len = j;
+	if (l->alloc_len > 2 * l->len) {
+		sparse_pts_tt * e = nut->alloc->realloc(l->e, MAX(l->len, 1) * sizeof(sparse_pts_tt));
+		if (e) { l->e = e; l->alloc_len = MAX(l->len, 1); }
+	}
+}
+
+static int thin_syncpoints(nut_context_tt * nut) {
+	// halves the syncpoint cache. What is known about the regions of dropped
+	// syncpoints is kept in the next one, which is marked as merged.
+	syncpoint_list_tt * sl = &nut->syncpoints;
+	int len = sl->len, i, j;
+	syncpoint_tt * s;
+	if (len <= 3) return 0;
+	for (i = 0; i < nut->stream_count; i++) { // eor merging needs the old keys
+		thin_sparse(nut, &sl->eor[i], &sl->keys[i], len);
+		thin_sparse(nut, &sl->keys[i], NULL, len);
+	}
+	for (i = j = 1; i < len; i++) {
+		if (!thin_kept(i, len)) continue;
+		if (!thin_kept(i - 1, len)) {
+			int valid = sl->s[i-1].pts_valid && sl->s[i].pts_valid;
+			sl->s[j] = sl->s[i];
+			sl->s[j].pts_valid = valid;
+			sl->s[j].merged = 1;
+			sl->s[j-1].seen_next = 0;
+		} else sl->s[j] = sl->s[i];
+		j++;
+	}
+	sl->len = j;
+	if ((s = nut->alloc->realloc(sl->s, sl->len * sizeof(syncpoint_tt)))) {
+		sl->s = s;
+		sl->alloc_len = sl->len;
+	}
+	for (i = 0; sl->bounds && i < nut->stream_count; i++) { // rebuilt on the next seek
+		nut->alloc->free(sl->bounds[i].key_hi);
+		nut->alloc->free(sl->bounds[i].key_lo);
+		nut->alloc->free(sl->bounds[i].eor_lo);
+		sl->bounds[i] = (seek_bounds_tt){ NULL, NULL, NULL };
+	}
+	sl->bounds_bytes = 0;
+	sl->bounds_valid = 0;
+	return len - sl->len;
+}
+
+static int check_memory(nut_context_tt * nut) {
+	// only called where no seek holds indexes into the syncpoint cache
 	int err = 0;
-	while (sl->linked) {
-		syncpoint_linked_tt * s = sl->linked;
-		CHECK(add_syncpoint(nut, s->s, s->pts_eor, s->pts_eor + nut->stream_count, NULL));
-		sl->linked = s->prev;
-		nut->alloc->free(s);
+	drop_inside_syncpoints(nut);
+	memory_update(nut);
+	while (nut->dopts.memory_limit && nut->memory.total > nut->dopts.memory_limit) {
+		// thinning cannot help if the rest is over the limit by itself
+		if (nut->memory.total - nut->memory.current[NUT_MEM_SYNCPOINTS] >= nut->dopts.memory_limit) break;
+		CHECK(flush_syncpoint_queue(nut));
+		if (nut->syncpoints.shared) break; // not counted, it costs this context nothing
+		if (!thin_syncpoints(nut)) break; // nothing left to drop
+		nut->memory.thinned++;
+		memory_update(nut);
 	}
 err_out:
 	return err;
@@ -547,24 +1094,34 @@ static void set_global_pts(nut_context_tt * nut, uint64_t pts) {
 static int get_syncpoint(nut_context_tt * nut) {
 	int err = 0;
 	syncpoint_tt s;
-	int after_seek = nut->last_syncpoint ? 0 : 1;
+	int after_seek = nut->last_syncpoint ? 0 : 1, again;
 	input_buffer_tt itmp, * tmp = new_mem_buffer(&itmp);
 
 	s.pos = bctello(nut->i) - 8;
 
-	if (nut->last_syncpoint == s.pos) after_seek = 1; // don't go through the same syncpoint twice
-	nut->last_syncpoint = s.pos;
+	if ((again = nut->last_syncpoint == s.pos)) after_seek = 1; // don't go through the same syncpoint twice
 
-	CHECK(get_header(nut->i, tmp));
+	err = get_header(nut->i, tmp);
+	if (err == NUT_ERR_EAGAIN) goto err_out; // nothing was read, the next try is not a second time through it
+	nut->last_syncpoint = s.pos;
+	CHECK(err);
+	if (!again && !nut->seek_status) {
+		nut->stats.syncpoints++;
+		nut->stats.syncpoint_bytes += bctello(nut->i) - s.pos;
+	}
 
 	GET_V(tmp, s.pts);
 	GET_V(tmp, s.back_ptr);
 	s.back_ptr = s.back_ptr * 16 + 15;
+	probe(syncpoint_read, s.pos, s.pts, s.back_ptr, nut->seek_status);
 
 	set_global_pts(nut, s.pts);
 
 	s.seen_next = 0;
 	s.pts_valid = !after_seek;
+	s.merged = 0;
+	s.inside = 0;
+	s.pts_unknown = 0;
 	if (nut->dopts.cache_syncpoints) { // either we're using syncpoint cache, or we're seeking and we need the cache
 		int i;
 		uint64_t pts[nut->stream_count];
@@ -577,8 +1134,10 @@ static int get_syncpoint(nut_context_tt * nut) {
 		}
 		if (nut->dopts.cache_syncpoints & 2) // during seeking, syncpoints go into cache immediately
 			CHECK(add_syncpoint(nut, s, pts, eor, NULL));
-		else // otherwise, queue to a linked list to avoid CPU cache trashing during playback
+		else { // otherwise, queue to a linked list to avoid CPU cache trashing during playback
 			CHECK(queue_add_syncpoint(nut, s, pts, eor));
+			if (!nut->seek_status && !nut->find_syncpoint_state.i) CHECK(check_memory(nut));
+		}
 	}
 err_out:
 	return err;
@@ -589,8 +1148,10 @@ static int get_index(nut_context_tt * nut) {
 	int i, err = 0;
 	uint64_t max_pts;
 	syncpoint_list_tt * sl = &nut->syncpoints;
+	off_t start = bctello(nut->i) - 8; // startcode
 
 	CHECK(get_header(nut->i, tmp));
+	nut->stats.index_bytes = bctello(nut->i) - start;
 
 	GET_V(tmp, max_pts);
 	for (i = 0; i < nut->stream_count; i++) {
@@ -601,8 +1162,8 @@ static int get_index(nut_context_tt * nut) {
 	GET_V(tmp, sl->len);
 	sl->alloc_len = sl->len;
 	SAFE_REALLOC(nut->alloc, sl->s, sizeof(syncpoint_tt), sl->alloc_len);
-	SAFE_REALLOC(nut->alloc, sl->pts, nut->stream_count * sizeof(uint64_t), sl->alloc_len);
-	SAFE_REALLOC(nut->alloc, sl->eor, nut->stream_count * sizeof(uint64_t), sl->alloc_len);
+	for (i = 0; i < nut->stream_count; i++) sl->keys[i].len = sl->eor[i].len = 0;
+	sl->bounds_valid = 0;
 
 	for (i = 0; i < sl->len; i++) {
 		GET_V(tmp, sl->s[i].pos);
@@ -612,41 +1173,47 @@ static int get_index(nut_context_tt * nut) {
 		sl->s[i].pts = 0;
 		sl->s[i].seen_next = 1;
 		sl->s[i].pts_valid = 1;
+		sl->s[i].merged = 0;
+		sl->s[i].inside = 0;
+		sl->s[i].pts_unknown = 1;
 	}
 	for (i = 0; i < nut->stream_count; i++) {
+		sparse_list_tt * keys = &sl->keys[i];
 		int j;
 		uint64_t last_pts = 0; // all of pts[] array is off by one. using 0 for last pts is equivalent to -1 in spec.
 		for (j = 0; j < sl->len; ) {
-			int type, n, flag;
+			int type, n, flag, k = keys->len;
 			uint64_t x;
 			GET_V(tmp, x);
 			type = x & 1;
 			x >>= 1;
 			n = j;
+			// flagged syncpoints are entered with a dummy pts, filled below
 			if (type) {
 				flag = x & 1;
 				x >>= 1;
-				while (x--) if (n < sl->len) sl->pts[n++ * nut->stream_count + i] = flag;
-				if (n < sl->len) sl->pts[n++ * nut->stream_count + i] = !flag;
+				while (x--) if (n < sl->len) { if (flag) CHECK(sparse_set(nut, keys, n, 1)); n++; }
+				if (n < sl->len) { if (!flag) CHECK(sparse_set(nut, keys, n, 1)); n++; }
 			} else {
 				while (x != 1) {
-					sl->pts[n++ * nut->stream_count + i] = x & 1;
+					if (x & 1) CHECK(sparse_set(nut, keys, n, 1));
+					n++;
 					x >>= 1;
 					if (n == sl->len) break;
 				}
 			}
-			for(; j < n; j++) {
+			for(; k < keys->len; k++) {
 				int A, B = 0;
-				if (!sl->pts[j * nut->stream_count + i]) continue;
 				GET_V(tmp, A);
 				if (!A) {
 					GET_V(tmp, A);
 					GET_V(tmp, B);
-					sl->eor[j * nut->stream_count + i] = last_pts + A + B;
-				} else sl->eor[j * nut->stream_count + i] = 0;
-				sl->pts[j * nut->stream_count + i] = last_pts + A;
+					CHECK(sparse_set(nut, &sl->eor[i], keys->e[k].sp, last_pts + A + B));
+				}
+				keys->e[k].pts = last_pts + A;
 				last_pts += A + B;
 			}
+			j = n;
 		}
 	}
 
@@ -663,6 +1230,7 @@ static void clear_dts_cache(nut_context_tt * nut) {
 		for (j = 0; j < nut->sc[i].sh.decode_delay; j++) nut->sc[i].pts_cache[j] = -1;
 		nut->sc[i].last_dts = -1;
 	}
+	nut->max_dts_stream = -1;
 }
 
 static int get_packet(nut_context_tt * nut, nut_packet_tt * pd, int * saw_syncpoint) {
@@ -682,12 +1250,14 @@ static int get_packet(nut_context_tt * nut, nut_packet_tt * pd, int * saw_syncpo
 				CHECK(get_bytes(nut->i, 1, &tmp));
 				break;
 			case MAIN_STARTCODE:
+				start = bctello(nut->i) - 8;
 				while (tmp != SYNCPOINT_STARTCODE) {
 					ERROR(tmp >> 56 != 'N', NUT_ERR_NOT_FRAME_NOT_N);
 					CHECK(get_header(nut->i, NULL));
 					CHECK(get_bytes(nut->i, 8, &tmp));
 				}
 				nut->i->buf_ptr -= 8;
+				if (!nut->seek_status) nut->stats.header_bytes += bctello(nut->i) - start;
 				return -1;
 			case INFO_STARTCODE: if (nut->dopts.new_info && !nut->seek_status) {
 				CHECK(get_info_header(nut, &info));
@@ -703,6 +1273,13 @@ static int get_packet(nut_context_tt * nut, nut_packet_tt * pd, int * saw_syncpo
 	start = bctello(nut->i) - 1;
 
 	flags = nut->ft[tmp].flags;
+	if (nut->ft[tmp].simple) { // everything is in the table
+		pd->flags = flags & NUT_API_FLAGS;
+		pd->stream = nut->ft[tmp].stream;
+		pd->pts = nut->sc[pd->stream].last_pts + nut->ft[tmp].pts_delta;
+		pd->len = nut->ft[tmp].lsb;
+		goto check;
+	}
 	ERROR(flags & FLAG_INVALID, NUT_ERR_NOT_FRAME_NOT_N);
 
 	if (flags & FLAG_CODED) {
@@ -723,7 +1300,7 @@ static int get_packet(nut_context_tt * nut, nut_packet_tt * pd, int * saw_syncpo
 		if (coded_pts >= (1 << nut->sc[pd->stream].msb_pts_shift))
 			pd->pts = coded_pts - (1 << nut->sc[pd->stream].msb_pts_shift);
 		else {
-			int mask, delta;
+			int64_t mask, delta;
 			mask = (1 << nut->sc[pd->stream].msb_pts_shift)-1;
 			delta = nut->sc[pd->stream].last_pts - mask/2;
 			pd->pts = ((coded_pts - delta) & mask) + delta;
@@ -744,28 +1321,30 @@ static int get_packet(nut_context_tt * nut, nut_packet_tt * pd, int * saw_syncpo
 
 	if (flags & FLAG_CHECKSUM) {
 		CHECK(skip_buffer(nut->i, 4)); // header_checksum
-		ERROR(crc32(get_buf(nut->i, start), bctello(nut->i) - start), NUT_ERR_BAD_CHECKSUM);
+		CHECK(check_checksum(nut->i, start, bctello(nut->i) - start));
 		checksum = 1;
 	}
 
+check:
 	// error checking - max distance
 	ERROR(!after_sync && bctello(nut->i) + pd->len - nut->last_syncpoint > nut->max_distance, NUT_ERR_MAX_SYNCPOINT_DISTANCE);
 	ERROR(!checksum && pd->len > 2*nut->max_distance, NUT_ERR_MAX_DISTANCE);
 	// error checking - max pts distance
 	ERROR(!checksum && ABS((int64_t)pd->pts - (int64_t)nut->sc[pd->stream].last_pts) > nut->sc[pd->stream].max_pts_distance, NUT_ERR_MAX_PTS_DISTANCE);
-	// error checking - out of order dts
-	for (i = 0; i < nut->stream_count; i++) {
-		if (nut->sc[i].last_dts == -1) continue;
-		if (compare_ts(pd->pts, TO_TB(pd->stream), nut->sc[i].last_dts, TO_TB(i)) < 0)
-			debug_msg("%lld %d (%f) %lld %d (%f) \n",
-				pd->pts, pd->stream, TO_DOUBLE(pd->stream, pd->pts),
-				nut->sc[i].last_dts, i, TO_DOUBLE(i, nut->sc[i].last_dts));
-		ERROR(compare_ts(pd->pts, TO_TB(pd->stream), nut->sc[i].last_dts, TO_TB(i)) < 0, NUT_ERR_OUT_OF_ORDER);
+	// error checking - out of order dts, comparing to the highest one is enough
+	if ((i = nut->max_dts_stream) != -1 && compare_ts(pd->pts, TO_TB(pd->stream), nut->sc[i].last_dts, TO_TB(i)) < 0) {
+		debug_msg("%lld %d (%f) %lld %d (%f) \n",
+			pd->pts, pd->stream, TO_DOUBLE(pd->stream, pd->pts),
+			nut->sc[i].last_dts, i, TO_DOUBLE(i, nut->sc[i].last_dts));
+		ERROR(1, NUT_ERR_OUT_OF_ORDER);
 	}
 
+	nut->frame_header_len = bctello(nut->i) - start;
+	nut->frame_header_flags = flags;
+	probe(frame_header, start, pd->stream, pd->pts, pd->len, pd->flags, nut->frame_header_len);
 	if (saw_syncpoint) *saw_syncpoint = !!after_sync;
 err_out:
-	free_info_packet(nut, &info);
+	free_info_packet(nut->alloc, &info);
 	return err;
 }
 
@@ -773,9 +1352,18 @@ static void push_frame(nut_context_tt * nut, nut_packet_tt * pd) {
 	stream_context_tt * sc = &nut->sc[pd->stream];
 	sc->last_pts = pd->pts;
 	sc->last_dts = get_dts(sc->sh.decode_delay, sc->pts_cache, pd->pts);
+	update_max_dts(nut, pd->stream);
 	if (pd->flags & NUT_FLAG_KEY && !sc->last_key) sc->last_key = pd->pts + 1;
 	if (pd->flags & NUT_FLAG_EOR) sc->eor = pd->pts + 1;
 	else sc->eor = 0;
+	if (!nut->seek_status) { // not a frame skipped by nut_seek()
+		nut_stream_stats_tt * st = &nut->stream_stats[pd->stream];
+		st->frames++;
+		st->bytes += pd->len;
+		st->header_bytes += nut->frame_header_len;
+		if (nut->frame_header_flags & FLAG_CHECKSUM) st->checksum_frames++;
+		if (nut->frame_header_flags & FLAG_CODED) st->coded_frames++;
+	}
 }
 
 static int find_main_headers(nut_context_tt * nut) {
@@ -788,19 +1376,27 @@ static int find_main_headers(nut_context_tt * nut) {
 	if (read_data < len && buf_eof(nut->i) != NUT_ERR_EOF) return buf_eof(nut->i);
 
 	CHECK(get_bytes(nut->i, 7, &tmp)); // true EOF will fail here
-	len = (read_data -= 7);
-	while (len--) {
-		tmp = (tmp << 8) | *(nut->i->buf_ptr++);
-		if (tmp == MAIN_STARTCODE) break;
+	read_data -= 7;
+	{
 		// give up if we reach a syncpoint, unless we're searching the file end
-		if (tmp == SYNCPOINT_STARTCODE && nut->seek_status != 18 && !nut->last_syncpoint) break;
+		uint64_t stop = nut->seek_status != 18 && !nut->last_syncpoint ? SYNCPOINT_STARTCODE : MAIN_STARTCODE;
+		uint8_t * end = nut->i->buf_ptr + read_data;
+		uint8_t * p = find_startcode(nut->i->buf_ptr - 7, end, MAIN_STARTCODE, stop);
+		if (p) {
+			nut->i->buf_ptr = p + 8;
+			tmp = is_startcode(p, MAIN_STARTCODE, MAIN_STARTCODE) ? MAIN_STARTCODE : SYNCPOINT_STARTCODE;
+			len = 0;
+		} else {
+			nut->i->buf_ptr = end;
+			len = -1;
+		}
 	}
 	if (tmp == MAIN_STARTCODE) {
 		off_t pos = bctello(nut->i) - 8;
 		// load all headers into memory so they can be cleanly decoded without EAGAIN issues
 		// also check validity of the headers we just found
 		do {
-			if ((err = get_header(nut->i, NULL)) == NUT_ERR_EAGAIN) goto err_out;
+			if ((err = get_header_strict(nut->i, NULL)) == NUT_ERR_EAGAIN) goto err_out;
 			if (err) { tmp = err = 0; break; } // bad
 
 			// EOF is a legal error here - when reading the last headers in the file
@@ -848,24 +1444,26 @@ err_out:
 static int find_syncpoint(nut_context_tt * nut, syncpoint_tt * res, int backwards, off_t stop) {
 	int read;
 	int err = 0;
-	uint64_t tmp;
 	off_t ptr = 0;
 	assert(!backwards || !stop); // can't have both
 retry:
 	read = nut->max_distance;
+	if (backwards) hint_buf(nut->i, bctello(nut->i) - (nut->max_distance - 7), nut->max_distance);
 	if (stop) read = MIN(read, stop - bctello(nut->i));
-	read = ready_read_buf(nut->i, read);
+	read = MIN(ready_read_buf(nut->i, read), read + 10); // the buffer may hold much more, don't scan past the window
 	if (stop) read = MIN(read, stop - bctello(nut->i));
-	tmp = 0;
-
-	while (nut->i->buf_ptr - nut->i->buf < read) {
-		tmp = (tmp << 8) | *(nut->i->buf_ptr++);
-		if (tmp != SYNCPOINT_STARTCODE) continue;
+	for (;;) {
+		uint8_t * p = find_startcode(nut->i->buf_ptr, nut->i->buf + read, SYNCPOINT_STARTCODE, SYNCPOINT_STARTCODE);
+		if (!p) {
+			if (nut->i->buf_ptr - nut->i->buf < read) nut->i->buf_ptr = nut->i->buf + read;
+			break;
+		}
+		nut->i->buf_ptr = p + 8;
 		if (res) {
 			input_buffer_tt itmp, * tmp = new_mem_buffer(&itmp);
 			res->pos = bctello(nut->i) - 8;
 
-			if ((err = get_header(nut->i, tmp)) == NUT_ERR_EAGAIN) goto err_out;
+			if ((err = get_header_strict(nut->i, tmp)) == NUT_ERR_EAGAIN) goto err_out;
 			if (err) { err = 0; continue; }
 
 			GET_V(tmp, res->pts);
@@ -873,6 +1471,9 @@ retry:
 			res->back_ptr = res->back_ptr * 16 + 15;
 			res->seen_next = 0;
 			res->pts_valid = 0;
+			res->merged = 0;
+			res->inside = 0;
+			res->pts_unknown = 0;
 		}
 		if (!backwards) return 0;
 		else ptr = bctello(nut->i);
@@ -916,7 +1517,7 @@ static int smart_find_syncpoint(nut_context_tt * nut, syncpoint_tt * sp, int bac
 
 	if (i) i--;
 	else {
-		for (i = 0; i < sl->len; i++) if (sl->s[i].pos+15 > pos) break;
+		i = syncpoint_index(sl->s, sl->len, pos - 15) + 1; // first one with pos+15 > pos
 		ERROR(i == sl->len || (i && !sl->s[i-1].seen_next), -1);
 
 		// trust the caller if it gave more precise syncpoint location
@@ -960,11 +1561,8 @@ static int smart_find_syncpoint(nut_context_tt * nut, syncpoint_tt * sp, int bac
 			i = tmp + 1;
 		}
 
-		memmove(sl->s + begin, sl->s + i, (sl->len - i) * sizeof(syncpoint_tt));
-		memmove(sl->pts + begin * nut->stream_count, sl->pts + i * nut->stream_count, (sl->len - i) * nut->stream_count * sizeof(uint64_t));
-		memmove(sl->eor + begin * nut->stream_count, sl->eor + i * nut->stream_count, (sl->len - i) * nut->stream_count * sizeof(uint64_t));
-
-		sl->len -= i-begin;
+		CHECK(unshare_syncpoints(nut));
+		shift_syncpoints(nut, i, begin - i);
 
 		if (sp->pos < pos && !backwards) { // wow, how silly!
 			fss->pos = fss->i = fss->begin = fss->seeked = 0;
@@ -989,7 +1587,7 @@ err_out:
 	return err;
 }
 
-int nut_read_next_packet(nut_context_tt * nut, nut_packet_tt * pd) {
+static int read_packet(nut_context_tt * nut, nut_packet_tt * pd) {
 	int err = 0;
 	if (nut->seek_status) { // in error mode!
 		syncpoint_tt s;
@@ -1009,25 +1607,68 @@ int nut_read_next_packet(nut_context_tt * nut, nut_packet_tt * pd) {
 		else nut->i->buf_ptr = nut->i->buf + MIN(16, nut->i->read_len);
 
 		nut->seek_status = 1; // enter error mode
-		return nut_read_next_packet(nut, pd);
+		nut->stats.resyncs++;
+		probe(resync, err, nut->last_syncpoint);
+		return read_packet(nut, pd);
 	}
+err_out:
+	return err;
+}
 
-	if (!err) push_frame(nut, pd);
+int nut_read_next_packet(nut_context_tt * nut, nut_packet_tt * pd) {
+	int err = 0;
+	report_checksums(nut);
+	if (nut->i->buf_ptr != nut->i->buf) flush_buf(nut->i); // frame given by nut_read_frame_ref()
+	CHECK(read_packet(nut, pd));
+	push_frame(nut, pd);
 err_out:
 	if (err != NUT_ERR_EAGAIN) flush_buf(nut->i); // unless EAGAIN
 	else nut->i->buf_ptr = nut->i->buf; // rewind
 	return err;
 }
 
+int nut_read_packets(nut_context_tt * nut, nut_packet_tt * pd, const uint8_t ** data, int max, int * count) {
+	input_buffer_tt * bc = nut->i;
+	int err = 0, n = 0, end = 0, i;
+	report_checksums(nut);
+	if (bc->buf_ptr != bc->buf) flush_buf(bc);
+	*count = 0;
+	while (n < max) {
+		// nothing is flushed after the first frame, so all of them stay in the buffer
+		if (!n) err = read_packet(nut, &pd[n]);
+		else while ((err = get_packet(nut, &pd[n], NULL)) == -1);
+		if (!err && ready_read_buf(bc, pd[n].len) < pd[n].len) err = buf_eof(bc);
+		if (err) break;
+		push_frame(nut, &pd[n]);
+		// the buffer may still move while reading on, keep only the offset for now
+		data[n] = (const uint8_t *)(uintptr_t)(bc->buf_ptr - bc->buf);
+		bc->buf_ptr += pd[n].len;
+		end = bc->buf_ptr - bc->buf;
+		n++;
+	}
+	if (!n && err != NUT_ERR_EAGAIN) {
+		flush_buf(bc);
+		return err;
+	}
+	bc->buf_ptr = bc->buf + end; // drop whatever was parsed of an incomplete frame
+	for (i = 0; i < n; i++) data[i] = bc->buf + (uintptr_t)data[i];
+	*count = n;
+	return n ? 0 : err;
+}
+
 static int get_headers(nut_context_tt * nut, int read_info) {
 	int i, err = 0;
-	uint64_t tmp;
+	uint64_t tmp, index_bytes = nut->stats.index_bytes;
+	off_t start = bctello(nut->i);
 
 	CHECK(get_bytes(nut->i, 8, &tmp));
 	assert(tmp == MAIN_STARTCODE); // sanity, get_headers should only be called in this situation
 	CHECK(get_main_header(nut));
 
 	SAFE_CALLOC(nut->alloc, nut->sc, sizeof(stream_context_tt), nut->stream_count);
+	SAFE_CALLOC(nut->alloc, nut->stream_stats, sizeof(nut_stream_stats_tt), nut->stream_count);
+	SAFE_CALLOC(nut->alloc, nut->syncpoints.keys, sizeof(sparse_list_tt), nut->stream_count);
+	SAFE_CALLOC(nut->alloc, nut->syncpoints.eor, sizeof(sparse_list_tt), nut->stream_count);
 	for (i = 0; i < nut->stream_count; i++) nut->sc[i].sh.type = -1;
 
 	CHECK(get_bytes(nut->i, 8, &tmp));
@@ -1037,7 +1678,8 @@ static int get_headers(nut_context_tt * nut, int read_info) {
 		if (tmp == STREAM_STARTCODE) {
 			CHECK(get_stream_header(nut));
 		} else if (tmp == INFO_STARTCODE && read_info) {
-			SAFE_REALLOC(nut->alloc, nut->info, sizeof(nut_info_packet_tt), ++nut->info_count + 1);
+			nut->info_count++; // not in the macro, it evaluates its arguments twice
+			SAFE_REALLOC(nut->alloc, nut->info, sizeof(nut_info_packet_tt), nut->info_count + 1);
 			memset(&nut->info[nut->info_count - 1], 0, sizeof(nut_info_packet_tt));
 			CHECK(get_info_header(nut, &nut->info[nut->info_count - 1]));
 			nut->info[nut->info_count].count = -1;
@@ -1052,6 +1694,8 @@ static int get_headers(nut_context_tt * nut, int read_info) {
 		CHECK(err); // it's just barely possible for get_bytes to return a memory error, check for that
 	}
 	if (tmp == SYNCPOINT_STARTCODE) nut->i->buf_ptr -= 8;
+	nut->stats.header_bytes += bctello(nut->i) - start - (nut->stats.index_bytes - index_bytes);
+	nut->stats.streams = nut->stream_stats;
 
 	for (i = 0; i < nut->stream_count; i++) ERROR(nut->sc[i].sh.type == -1, NUT_ERR_NOSTREAM_STARTCODE);
 
@@ -1060,10 +1704,29 @@ err_out:
 	return err;
 }
 
+static int start_shared(nut_context_tt * nut) {
+	// nut_read_headers() of nut_demuxer_init_shared(), only finds where playback starts
+	int err = 0;
+	if (nut->i->isc.seek) {
+		seek_buf(nut->i, nut->syncpoints.s[0].pos, SEEK_SET);
+		nut->last_headers = nut->shared->last_headers;
+	} else {
+		// playback skips the headers like repeated ones
+		CHECK(find_main_headers(nut));
+	}
+err_out:
+	return err;
+}
+
 int nut_read_headers(nut_context_tt * nut, nut_stream_header_tt * s [], nut_info_packet_tt * info []) {
 	int i, err = 0;
 	syncpoint_tt sp;
 
+	if (nut->shared && !nut->last_headers) {
+		CHECK(start_shared(nut));
+		goto headers_out;
+	}
+
 	// step 1 - find headers and load to memory
 	if (!nut->last_headers) CHECK(find_main_headers(nut));
 
@@ -1109,15 +1772,22 @@ int nut_read_headers(nut_context_tt * nut, nut_stream_header_tt * s [], nut_info
 		nut->seek_status = 1;
 	}
 	CHECK(smart_find_syncpoint(nut, &sp, 0, 0));
-	CHECK(add_syncpoint(nut, sp, NULL, NULL, NULL));
+	{
+		uint64_t none[nut->stream_count]; // no frames before it, so no keyframes either
+		memset(none, 0, sizeof none);
+		sp.pts_valid = 1;
+		CHECK(add_syncpoint(nut, sp, none, none, NULL));
+	}
 	nut->i->buf_ptr = get_buf(nut->i, sp.pos); // rewind to the syncpoint, this is where playback starts...
 	nut->seek_status = 0;
 
+headers_out:
 	SAFE_CALLOC(nut->alloc, *s, sizeof(nut_stream_header_tt), nut->stream_count + 1);
 	for (i = 0; i < nut->stream_count; i++) (*s)[i] = nut->sc[i].sh;
 	(*s)[i].type = -1;
 	nut->tmp_buffer = (void*)*s;
 	if (info) *info = nut->info;
+	CHECK(check_memory(nut)); // the index may be over the limit by itself
 err_out:
 	if (err != NUT_ERR_EAGAIN) flush_buf(nut->i); // unless EAGAIN
 	else nut->i->buf_ptr = nut->i->buf; // rewind
@@ -1125,14 +1795,26 @@ err_out:
 }
 
 int nut_read_frame(nut_context_tt * nut, int * len, uint8_t * buf) {
-	int tmp = MIN(*len, nut->i->read_len - (nut->i->buf_ptr - nut->i->buf));
+	int tmp;
+	if (nut->i->map) ready_read_buf(nut->i, *len); // whole frame is already in memory
+	tmp = MIN(*len, nut->i->read_len - (nut->i->buf_ptr - nut->i->buf));
 	if (tmp) {
 		memcpy(buf, nut->i->buf_ptr, tmp);
 		nut->i->buf_ptr += tmp;
 		*len -= tmp;
 	}
-	if (*len) {
-		int read = nut->i->isc.read(nut->i->isc.priv, *len, buf + tmp);
+	if (*len && (nut->i->read_ahead || nut->i->read_ahead_align) && !nut->i->map) {
+		// through the buffer, so the read is as long and aligned as the options ask
+		int read = MIN(ready_read_buf(nut->i, *len), *len);
+		memcpy(buf + tmp, nut->i->buf_ptr, read);
+		nut->i->buf_ptr += read;
+		*len -= read;
+	} else if (*len && !nut->i->map) {
+		int read;
+		// reading around the buffer, so whatever is in it is no longer contiguous with the file position
+		flush_buf(nut->i);
+		nut->i->buf_ptr = nut->i->buf = nut->i->base;
+		read = nut->i->isc.read(nut->i->isc.priv, *len, buf + tmp);
 		nut->i->file_pos += read;
 		*len -= read;
 	}
@@ -1143,6 +1825,14 @@ int nut_read_frame(nut_context_tt * nut, int * len, uint8_t * buf) {
 	return 0;
 }
 
+int nut_read_frame_ref(nut_context_tt * nut, int len, const uint8_t ** buf) {
+	// not flushed here, so the data stays put until the next call
+	if (ready_read_buf(nut->i, len) < len) return buf_eof(nut->i);
+	*buf = nut->i->buf_ptr;
+	nut->i->buf_ptr += len;
+	return 0;
+}
+
 static off_t seek_interpolate(int max_distance, double time_pos, off_t lo, off_t hi, double lo_pd, double hi_pd, off_t fake_hi) {
 	double weight = 19./20.;
 	off_t guess;
@@ -1155,15 +1845,76 @@ static off_t seek_interpolate(int max_distance, double time_pos, off_t lo, off_t
 	return guess;
 }
 
+static int build_seek_bounds(nut_context_tt * nut) {
+	// running max/min of the key and eor pts of every stream, so nut_seek() can bisect them
+	syncpoint_list_tt * sl = &nut->syncpoints;
+	int i, j, err = 0;
+	if (sl->bounds_valid) return 0;
+	CHECK(unshare_syncpoints(nut));
+	if (!sl->bounds) SAFE_CALLOC(nut->alloc, sl->bounds, sizeof(seek_bounds_tt), nut->stream_count);
+	for (i = 0; i < nut->stream_count; i++) {
+		sparse_list_tt * keys = &sl->keys[i], * eor = &sl->eor[i];
+		seek_bounds_tt * b = &sl->bounds[i];
+		int first = sparse_find(keys, 1);
+		SAFE_REALLOC(nut->alloc, b->key_hi, sizeof(uint64_t), keys->len + 1);
+		SAFE_REALLOC(nut->alloc, b->key_lo, sizeof(uint64_t), keys->len + 1);
+		SAFE_REALLOC(nut->alloc, b->eor_lo, sizeof(uint64_t), eor->len + 1);
+		for (j = first; j < keys->len; j++) b->key_hi[j] = j > first ? MAX(b->key_hi[j-1], keys->e[j].pts) : keys->e[j].pts;
+		for (j = keys->len; j-- > first; ) b->key_lo[j] = j+1 < keys->len ? MIN(b->key_lo[j+1], keys->e[j].pts) : keys->e[j].pts;
+		first = sparse_find(eor, 1);
+		for (j = eor->len; j-- > first; ) b->eor_lo[j] = j+1 < eor->len ? MIN(b->eor_lo[j+1], eor->e[j].pts) : eor->e[j].pts;
+	}
+	sl->bounds_bytes = nut->stream_count * sizeof(seek_bounds_tt);
+	for (i = 0; i < nut->stream_count; i++) sl->bounds_bytes += (2 * (sl->keys[i].len + 1) + sl->eor[i].len + 1) * sizeof(uint64_t);
+	sl->bounds_valid = 1;
+err_out:
+	return err;
+}
+
+static int first_above(const uint64_t * v, int lo, int hi, uint64_t pts) {
+	// v[] is non-decreasing in [lo, hi), returns the first index with v > pts, or hi
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (v[mid] > pts) hi = mid;
+		else lo = mid + 1;
+	}
+	return lo;
+}
+
+static int syncpoint_after(nut_context_tt * nut, int i, const uint64_t * timebases, int stream, uint64_t pts) {
+	// s[i].pts is after the target, which is timebases[] or else pts of stream.
+	// A syncpoint at the target can have frames of an earlier pts before
+	// the one at the target, so it is where a search starts, not where it ends.
+	TO_PTS(tmp, nut->syncpoints.s[i].pts)
+	if (timebases) return timebases[tmp_tb] < tmp_p;
+	return compare_ts(tmp_p, nut->tb[tmp_tb], pts, TO_TB(stream)) > 0;
+}
+
+static int first_syncpoint_after(nut_context_tt * nut, const uint64_t * timebases, int stream, uint64_t pts) {
+	// first syncpoint whose known pts is after the target, sl->len if none.
+	// Known pts never go backwards, but index entries with unknown pts are
+	// mixed in. A bisection which meets one finishes linearly in what is left.
+	syncpoint_list_tt * sl = &nut->syncpoints;
+	int lo = 0, hi = sl->len;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (sl->s[mid].pts_unknown) break;
+		if (syncpoint_after(nut, mid, timebases, stream, pts)) hi = mid;
+		else lo = mid + 1;
+	}
+	for (; lo < hi; lo++) if (!sl->s[lo].pts_unknown && syncpoint_after(nut, lo, timebases, stream, pts)) break;
+	return lo;
+}
+
 static int binary_search_syncpoint(nut_context_tt * nut, double time_pos, off_t * start, off_t * end, syncpoint_tt * stopper) {
 	int i, err = 0;
 	syncpoint_tt s;
 	off_t fake_hi, * guess = &nut->binary_guess;
-	uint64_t timebases[nut->timebase_count];
+	uint64_t * timebases = nut->seek_pts; // time_pos in every timebase
 	syncpoint_list_tt * sl = &nut->syncpoints;
 	int a = 0;
-	for (i = 0; i < nut->timebase_count; i++) timebases[i] = (uint64_t)(time_pos / nut->tb[i].num * nut->tb[i].den);
 	assert(sl->len); // it is impossible for the first syncpoint to not have been read
+	probe(bisect_start, timebases[0], sl->len);
 
 	// find last syncpoint if it's not already found
 	if (!sl->s[sl->len-1].seen_next) {
@@ -1173,15 +1924,36 @@ static int binary_search_syncpoint(nut_context_tt * nut, double time_pos, off_t
 		CHECK(find_syncpoint(nut, &s, 1, 0));
 		CHECK(add_syncpoint(nut, s, NULL, NULL, &i));
 		assert(i == sl->len-1);
+		CHECK(unshare_syncpoints(nut));
 		sl->s[i].seen_next = 1;
 		nut->seek_status = 0;
 	}
 	// sl->len MUST be >=2, which is the first and last syncpoints in the file
 	ERROR(sl->len < 2, NUT_ERR_NOT_SEEKABLE);
 
-	for (i = 0; i < sl->len; i++) {
-		TO_PTS(tmp, sl->s[i].pts)
-		if (timebases[tmp_tb] <= tmp_p) break;
+	for (;;) {
+		int j;
+		i = first_syncpoint_after(nut, timebases, 0, 0);
+		if (!i || !sl->s[i-1].pts_unknown) break;
+		// the syncpoint before it is an index entry with unknown pts, the
+		// target may be anywhere in the run of those. Read the middle one.
+		for (j = i - 1; j && sl->s[j-1].pts_unknown; j--);
+		j += (i - 1 - j) / 2;
+		if (!nut->seek_status) {
+			seek_buf(nut->i, sl->s[j].pos, SEEK_SET);
+			if (nut->i->trace) nut->i->trace->probes++;
+		}
+		a++;
+		// index positions are rounded down to 16, the startcode is all in the window
+		nut->seek_status = (sl->s[j].pos + 16 + 7) << 1;
+		CHECK(find_syncpoint(nut, &s, 0, sl->s[j].pos + 16 + 7));
+		nut->seek_status = 0;
+		ERROR(s.seen_next, NUT_ERR_NOT_SEEKABLE); // the index points at no syncpoint
+		CHECK(unshare_syncpoints(nut));
+		sl->s[j].pos = s.pos;
+		sl->s[j].pts = s.pts;
+		sl->s[j].back_ptr = s.back_ptr;
+		sl->s[j].pts_unknown = 0;
 	}
 
 	if (i == sl->len) { // there isn't any syncpoint bigger than requested
@@ -1204,22 +1976,37 @@ static int binary_search_syncpoint(nut_context_tt * nut, double time_pos, off_t
 
 	while (!LO.seen_next) {
 		// start binary search between LO (sl->s[i].pos) to HI (sl->s[i+1].pos) ...
-		if (!*guess) *guess = seek_interpolate(nut->max_distance*2, time_pos, LO.pos, HI.pos, TO_DOUBLE_PTS(LO.pts), TO_DOUBLE_PTS(HI.pts), fake_hi);
+		if (!*guess) {
+			*guess = seek_interpolate(nut->max_distance*2, time_pos, LO.pos, HI.pos, TO_DOUBLE_PTS(LO.pts), TO_DOUBLE_PTS(HI.pts), fake_hi);
+			if (nut->i->trace) nut->i->trace->probes++;
+		}
 
 		debug_msg("\n%d [ (%d,%.3f) .. (%d,%.3f) .. (%d(%d),%.3f) ] ", i, (int)LO.pos, TO_DOUBLE_PTS(LO.pts), (int)*guess, time_pos,
 		                                                                   (int)HI.pos, (int)fake_hi, TO_DOUBLE_PTS(HI.pts));
 		a++;
+		probe(bisect_probe, *guess, LO.pos, fake_hi);
+
+		if (!nut->seek_status) {
+			// whatever this probe finds, the next one reads one of these
+			int len = nut->max_distance;
+			hint_buf(nut->i, *guess, len);
+			hint_buf(nut->i, *guess - len + 7, len);
+			if (*guess - LO.pos > 2*len) hint_buf(nut->i, (LO.pos + *guess) / 2, len);
+			if (fake_hi - *guess > 2*len) hint_buf(nut->i, (*guess + fake_hi) / 2, len);
+		}
 
 		if (!(nut->seek_status & 1)) {
 			if (!nut->seek_status) seek_buf(nut->i, *guess, SEEK_SET);
 			nut->seek_status = fake_hi << 1;
 			CHECK(find_syncpoint(nut, &s, 0, fake_hi));
 			nut->seek_status = 0;
+			if (nut->i->trace && (s.seen_next == 1 || s.pos >= fake_hi)) nut->i->trace->missed_guesses++;
 		}
 
 scan_backwards:
 		if (nut->seek_status & 1 || s.seen_next == 1 || s.pos >= fake_hi) { // we got back to 'HI'
 			if (*guess == LO.pos + 16) { // we are done!
+				CHECK(unshare_syncpoints(nut));
 				LO.seen_next = 1;
 				break;
 			}
@@ -1252,6 +2039,7 @@ scan_backwards:
 	*end = HI.pos;
 	*stopper = HI;
 err_out:
+	probe(bisect_done, err, a, *start, *end);
 	if (err == NUT_ERR_EAGAIN) nut->i->buf_ptr = nut->i->buf;
 	return err;
 }
@@ -1263,6 +2051,7 @@ static int linear_search_seek(nut_context_tt * nut, int backwards, off_t start,
 	off_t buf_before = 0;
 	off_t stopper_syncpoint = 0;
 
+	probe(linear_start, start, end, nut->seek_status);
 	if (nut->seek_status <= 1) {
 		syncpoint_tt s;
 		if (!nut->seek_status) seek_buf(nut->i, start, SEEK_SET);
@@ -1278,13 +2067,9 @@ static int linear_search_seek(nut_context_tt * nut, int backwards, off_t start,
 
 	if (stopper) {
 		off_t back_ptr = stopper->pos - stopper->back_ptr;
-		for (i = 1; i < sl->len; i++) {
-			if (sl->s[i].pos > back_ptr + 15) {
-				// no need to worry about this being exact or not - if we're using stopper, that means we don't have an index
-				if (sl->s[i-1].seen_next) stopper_syncpoint = sl->s[i].pos;
-				break;
-			}
-		}
+		i = MAX(syncpoint_index(sl->s, sl->len, back_ptr + 15) + 1, 1);
+		// no need to worry about this being exact or not - if we're using stopper, that means we don't have an index
+		if (i < sl->len && sl->s[i-1].seen_next) stopper_syncpoint = sl->s[i].pos;
 		if (stopper_syncpoint > bctello(nut->i)) stopper_syncpoint = 0; // do not load stopper_syncpoint position before it is actually reached
 	}
 
@@ -1352,6 +2137,7 @@ static int linear_search_seek(nut_context_tt * nut, int backwards, off_t start,
 
 		CHECK_break(skip_buffer(nut->i, pd.len));
 		push_frame(nut, &pd);
+		if (nut->i->trace) nut->i->trace->scan_bytes += bctello(nut->i) - buf_before;
 	}
 	if (!end) goto err_out; // forward seek
 
@@ -1368,9 +2154,15 @@ static int linear_search_seek(nut_context_tt * nut, int backwards, off_t start,
 	// after ALL this, we ended up in a worse position than where we were...
 	ERROR(!backwards && min_pos < nut->before_seek, NUT_ERR_NOT_SEEKABLE);
 
-	for (i = 1; i < sl->len; i++) if (sl->s[i].pos > min_pos) break;
-	i--;
-	if (!(nut->seek_status & 1)) seek_buf(nut->i, sl->s[i].pos, SEEK_SET);
+	i = MAX(syncpoint_index(sl->s, sl->len, min_pos), 0);
+	if (!(nut->seek_status & 1)) {
+		seek_buf(nut->i, sl->s[i].pos, SEEK_SET);
+		if (sl->shared) { // index positions are rounded down to 16, a shared list is not corrected
+			syncpoint_tt s;
+			CHECK(find_syncpoint(nut, &s, 0, sl->s[i].pos + 15 + 8));
+			if (!s.seen_next) seek_buf(nut->i, s.pos, SEEK_SET);
+		}
+	}
 
 	nut->seek_status |= 1;
 	nut->last_syncpoint = 0; // last_key is invalid
@@ -1379,10 +2171,12 @@ static int linear_search_seek(nut_context_tt * nut, int backwards, off_t start,
 
 	while (bctello(nut->i) < min_pos) {
 		nut_packet_tt pd;
+		off_t pos = bctello(nut->i);
 		while ((err = get_packet(nut, &pd, NULL)) == -1);
 		CHECK(err);
 		push_frame(nut, &pd);
 		CHECK(skip_buffer(nut->i, pd.len));
+		if (nut->i->trace) nut->i->trace->scan_bytes += bctello(nut->i) - pos;
 	}
 	err = 0;
 
@@ -1402,74 +2196,167 @@ err_out:
 		nut->seek_status = 0;
 	} else if (buf_before) nut->i->buf_ptr = get_buf(nut->i, buf_before); // rewind smart
 	else nut->i->buf_ptr = nut->i->buf; // just rewind
+	probe(linear_done, err, bctello(nut->i));
 	return err;
 }
 
-int nut_seek(nut_context_tt * nut, double time_pos, int flags, const int * active_streams) {
+static int read_merged_region(nut_context_tt * nut) {
+	// reads from the syncpoint before nut->seek_expand up to it, which adds
+	// the syncpoints in between with their keyframes, as playback would have
+	syncpoint_list_tt * sl = &nut->syncpoints;
+	off_t buf_before = 0;
 	int err = 0;
-	off_t start = 0, end = 0;
-	int backwards = flags & 1 ? time_pos < 0 : 1;
-	syncpoint_tt stopper = { 0, 0, 0, 0, 0 };
 
-	if (!nut->i->isc.seek) return NUT_ERR_NOT_SEEKABLE;
+	if (nut->seek_status <= 1) {
+		syncpoint_tt s;
+		off_t start = sl->s[syncpoint_index(sl->s, sl->len, nut->seek_expand - 1)].pos;
+		if (!nut->seek_status) seek_buf(nut->i, start, SEEK_SET);
+		nut->seek_status = 1;
+		CHECK(find_syncpoint(nut, &s, 0, start + 16 + 7)); // index positions are rounded down to 16
+		ERROR(s.seen_next, NUT_ERR_NOT_SEEKABLE);
+		seek_buf(nut->i, s.pos, SEEK_SET);
+		nut->seek_status = s.pos << 1;
+		nut->last_syncpoint = 0; // last_key is invalid
+		clear_dts_cache(nut);
+	}
 
-	if (!nut->before_seek) {
-		int i;
-		nut->before_seek = bctello(nut->i);
+	for (;;) {
+		int saw_syncpoint;
+		nut_packet_tt pd;
 
-		for (i = 0; i < nut->stream_count; i++) {
-			nut->sc[i].state.old_last_pts = nut->sc[i].last_pts;
-			nut->sc[i].state.active = active_streams ? 0 : 1;
-			nut->sc[i].state.good_key = nut->sc[i].state.pts_higher = 0;
+		buf_before = bctello(nut->i);
+		ERROR(buf_before > nut->seek_expand + 15, NUT_ERR_NOT_SEEKABLE); // the syncpoint is not where it was
+		err = get_packet(nut, &pd, &saw_syncpoint);
+		if (err == -1) continue;
+		CHECK(err);
+		if (saw_syncpoint) {
+			int header_size = bctello(nut->i) - buf_before;
+			if (buf_before >= nut->seek_expand) break; // it was added with its keyframes
+			nut->i->buf_ptr -= header_size; // the region can be large, flush at every syncpoint
+			flush_buf(nut->i);
+			nut->i->buf_ptr += header_size;
 		}
-		if (active_streams) for (i = 0; active_streams[i] != -1; i++) nut->sc[active_streams[i]].state.active = 1;
-
-		if (flags & 1) { // relative seek
-			uint64_t orig_pts = 0;
-			int orig_timebase = 0;
-			for (i = 0; i < nut->stream_count; i++) {
-				uint64_t dts = nut->sc[i].last_dts != -1 ? nut->sc[i].last_dts : nut->sc[i].last_pts;
-				if (!nut->sc[i].state.active) continue;
-				if (compare_ts(orig_pts, nut->tb[orig_timebase], dts, TO_TB(i)) < 0) {
-					orig_pts = dts;
-					orig_timebase = nut->sc[i].timebase_id;
-				}
-			}
-			time_pos += TO_DOUBLE(orig_timebase, orig_pts);
+		CHECK(skip_buffer(nut->i, pd.len));
+		push_frame(nut, &pd);
+		if (nut->i->trace) nut->i->trace->scan_bytes += bctello(nut->i) - buf_before;
+	}
+
+err_out:
+	if (err == NUT_ERR_EAGAIN) {
+		if (buf_before) nut->i->buf_ptr = get_buf(nut->i, buf_before);
+		else nut->i->buf_ptr = nut->i->buf;
+		return err;
+	}
+	// after a NUT error the rest of the region has no keyframes, the seek searches it without them
+	nut->seek_expand = 0;
+	nut->seek_status = 0;
+	nut->last_syncpoint = 0;
+	clear_dts_cache(nut);
+	return err == NUT_ERR_OUT_OF_MEM ? err : 0;
+}
+
+static int expand_merged_syncpoint(nut_context_tt * nut, int m) {
+	// s[m] only has the first keyframes of the syncpoints thin_syncpoints()
+	// merged into it, which can move a seek. Its region is read again.
+	syncpoint_list_tt * sl = &nut->syncpoints;
+	uint64_t zero[nut->stream_count];
+	int j, err = 0;
+
+	CHECK(unshare_syncpoints(nut));
+	for (j = m - 1; sl->s[j].inside; j--); // syncpoints found inside it are read again too
+	shift_syncpoints(nut, m, j + 1 - m);
+	sl->inside -= m - j - 1;
+	m = j + 1;
+	memset(zero, 0, sizeof zero);
+	CHECK(set_syncpoint_pts(nut, m, zero, zero));
+	sl->s[m].merged = 0;
+	sl->s[m].pts_valid = 0;
+	nut->seek_expand = sl->s[m].pos;
+	nut->seek_status = 0;
+	CHECK(read_merged_region(nut));
+err_out:
+	return err;
+}
+
+static void start_seek(nut_context_tt * nut, const int * active_streams, uint64_t * orig_pts, int * orig_timebase) {
+	// orig is where a relative seek starts from, the highest dts of the active streams
+	int i;
+	if (nut->i->buf_ptr != nut->i->buf) flush_buf(nut->i); // frame given by nut_read_frame_ref()
+	nut->before_seek = bctello(nut->i);
+
+	for (i = 0; i < nut->stream_count; i++) {
+		nut->sc[i].state.old_last_pts = nut->sc[i].last_pts;
+		nut->sc[i].state.active = active_streams ? 0 : 1;
+		nut->sc[i].state.good_key = nut->sc[i].state.pts_higher = 0;
+	}
+	if (active_streams) for (i = 0; active_streams[i] != -1; i++) nut->sc[active_streams[i]].state.active = 1;
+
+	*orig_pts = 0;
+	*orig_timebase = 0;
+	for (i = 0; i < nut->stream_count; i++) {
+		uint64_t dts = nut->sc[i].last_dts != -1 ? nut->sc[i].last_dts : nut->sc[i].last_pts;
+		if (!nut->sc[i].state.active) continue;
+		if (compare_ts(*orig_pts, nut->tb[*orig_timebase], dts, TO_TB(i)) < 0) {
+			*orig_pts = dts;
+			*orig_timebase = nut->sc[i].timebase_id;
 		}
-		if (time_pos < 0.) time_pos = 0.;
+	}
+}
 
-		for (i = 0; i < nut->stream_count; i++) nut->sc[i].state.pts = (uint64_t)(time_pos / TO_TB(i).num * TO_TB(i).den);
-		nut->seek_time_pos = time_pos;
+static int seek_target(nut_context_tt * nut, int flags, int backwards, int fresh) {
+	// the target is in nut->seek_pts and seek_time_pos, fresh if start_seek() was just called
+	int err = 0;
+	off_t start = 0, end = 0;
+	double time_pos = nut->seek_time_pos;
+	syncpoint_tt stopper = { 0, 0, 0, 0, 0 };
+
+	probe(seek_start, nut->seek_pts[0], flags, fresh);
+	if (fresh) {
+		int i;
+		if ((nut->i->trace = nut->dopts.seek_trace)) memset(nut->i->trace, 0, sizeof(nut_seek_trace_tt));
+		for (i = 0; i < nut->stream_count; i++) nut->sc[i].state.pts = nut->seek_pts[nut->sc[i].timebase_id];
+		CHECK(flush_syncpoint_queue(nut)); // before the seek, played syncpoints in merged regions are dropped
 		nut->dopts.cache_syncpoints |= 2;
-		CHECK(flush_syncpoint_queue(nut));
-	} else {
-		time_pos = nut->seek_time_pos;
 	}
 
-	if (nut->syncpoints.s[nut->syncpoints.len-1].seen_next) {
+	if (nut->seek_expand) CHECK(read_merged_region(nut)); // resumed
+
+	while (nut->syncpoints.s[nut->syncpoints.len-1].seen_next) {
 		syncpoint_list_tt * sl = &nut->syncpoints;
 		int i;
 		int sync[nut->stream_count];
 		int good_sync = -2;
 		int last_sync = 0;
+		int forward = 0;
 		int backup = -1;
+		int merged = 0;
 		for (i = 0; i < nut->stream_count; i++) sync[i] = -1;
 
-		for (i = 1; i < sl->len; i++) {
-			int j;
-			if (!sl->s[i].pts_valid) continue;
-			for (j = 0; j < nut->stream_count; j++) {
-				uint64_t tmp;
-				if (!nut->sc[j].state.active) continue;
-				tmp = sl->pts[i * nut->stream_count + j];
-				if (tmp--) { // -- because all pts array is off-by-one. Zero indicates no keyframe.
-					if (tmp > nut->sc[j].state.pts) { if (!last_sync) last_sync = i; }
-					else sync[j] = (i-1);
-				}
-				tmp = sl->eor[i * nut->stream_count + j];
-				if (tmp--) if (tmp <= nut->sc[j].state.pts) sync[j] = -(i+1); // flag stream eor
-			}
+		CHECK(build_seek_bounds(nut));
+		// keys and eor only have entries for syncpoints with pts_valid
+		for (i = 0; i < nut->stream_count; i++) {
+			sparse_list_tt * l = &sl->keys[i];
+			seek_bounds_tt * b = &sl->bounds[i];
+			uint64_t pts = nut->sc[i].state.pts + 1; // all pts are off-by-one
+			int j, first, key = -1, eor = -1, next = 0;
+			if (!nut->sc[i].state.active) continue;
+			first = sparse_find(l, 1);
+			// earliest keyframe after pts, and the last one at or before it
+			j = first_above(b->key_hi, first, l->len, pts);
+			if (j < l->len && (!last_sync || l->e[j].sp < last_sync)) last_sync = next = l->e[j].sp;
+			j = first_above(b->key_lo, first, l->len, pts);
+			if (j > first) key = l->e[j-1].sp;
+			if (next && (!forward || next < forward)) forward = next;
+			l = &sl->eor[i];
+			first = sparse_find(l, 1);
+			j = first_above(b->eor_lo, first, l->len, pts);
+			if (j > first) eor = l->e[j-1].sp;
+			// a merged region only has its first keyframes, the ones after them are needed
+			if (key != -1 && sl->s[key].merged) merged = key;
+			if (next && sl->s[next].merged) merged = next;
+			if (eor != -1 && sl->s[eor].merged) merged = eor;
+			if (eor != -1 && eor >= key) sync[i] = -(eor+1); // flag stream eor
+			else if (key != -1) sync[i] = key - 1;
 		}
 		for (i = 0; i < nut->stream_count; i++) {
 			if (!nut->sc[i].state.active) continue;
@@ -1482,11 +2369,19 @@ int nut_seek(nut_context_tt * nut, double time_pos, int flags, const int * activ
 			for (i = good_sync; i <= last_sync; i++) if (!sl->s[i].pts_valid) break;
 			if (i != last_sync+1 && good_sync <= last_sync) good_sync = -1;
 		} else good_sync = -1;
+		if (good_sync >= 0 && sl->s[good_sync + 1].merged) merged = good_sync + 1;
+		if (good_sync >= 0 && forward && sl->s[forward].merged) merged = forward;
+		if (merged) { // split it and look again
+			CHECK(expand_merged_syncpoint(nut, merged));
+			continue;
+		}
 		if (good_sync >= 0) {
+			if (nut->i->trace) nut->i->trace->used_index = 1;
 			start = sl->s[good_sync].pos;
 			end = sl->s[++good_sync].pos;
-			if (flags & 2) end = sl->s[last_sync - 1].pos; // for forward seek
+			if (flags & 2) end = sl->s[forward - 1].pos; // for forward seek
 		}
+		break;
 	}
 
 	if (start == 0) CHECK(binary_search_syncpoint(nut, time_pos, &start, &end, &stopper));
@@ -1505,13 +2400,139 @@ err_out:
 		syncpoint_list_tt * sl = &nut->syncpoints;
 		flush_buf(nut->i);
 		nut->before_seek = 0;
+		nut->seek_expand = 0;
+		nut->i->trace = NULL;
 		nut->dopts.cache_syncpoints &= ~2;
-		if (!nut->dopts.cache_syncpoints && sl->len > 1) {
+		drop_inside_syncpoints(nut);
+		if (!nut->dopts.cache_syncpoints && sl->len > 1 && !sl->shared) {
 			sl->s[1] = sl->s[sl->len - 1];
 			sl->len = 2;
 			sl->s[0].seen_next = 0;
 		}
+		if (!err) err = check_memory(nut);
 	}
+	probe(seek_done, err, bctello(nut->i));
+	return err;
+}
+
+int nut_seek(nut_context_tt * nut, double time_pos, int flags, const int * active_streams) {
+	int backwards = flags & 1 ? time_pos < 0 : 1;
+	int fresh = !nut->before_seek;
+
+	report_checksums(nut);
+	if (!nut->i->isc.seek) return NUT_ERR_NOT_SEEKABLE;
+
+	if (fresh) {
+		uint64_t orig_pts;
+		int i, orig_timebase;
+		start_seek(nut, active_streams, &orig_pts, &orig_timebase);
+		if (flags & 1) time_pos += TO_DOUBLE(orig_timebase, orig_pts); // relative seek
+		if (time_pos < 0.) time_pos = 0.;
+
+		for (i = 0; i < nut->timebase_count; i++) nut->seek_pts[i] = (uint64_t)(time_pos / nut->tb[i].num * nut->tb[i].den);
+		nut->seek_time_pos = time_pos;
+	}
+	return seek_target(nut, flags, backwards, fresh);
+}
+
+int nut_seek_pts(nut_context_tt * nut, int stream, int64_t pts, int flags, const int * active_streams) {
+	int backwards = flags & 1 ? pts < 0 : 1;
+	int fresh = !nut->before_seek;
+
+	report_checksums(nut);
+	if (!nut->i->isc.seek) return NUT_ERR_NOT_SEEKABLE;
+	if (stream < 0 || stream >= nut->stream_count) return NUT_ERR_GENERAL_ERROR;
+
+	if (fresh) {
+		uint64_t orig_pts;
+		int i, orig_timebase;
+		start_seek(nut, active_streams, &orig_pts, &orig_timebase);
+		if (flags & 1) pts += convert_ts(orig_pts, nut->tb[orig_timebase], TO_TB(stream)); // relative seek
+		if (pts < 0) pts = 0;
+
+		for (i = 0; i < nut->timebase_count; i++) nut->seek_pts[i] = convert_ts(pts, TO_TB(stream), nut->tb[i]);
+		nut->seek_time_pos = TO_DOUBLE(nut->sc[stream].timebase_id, pts);
+	}
+	return seek_target(nut, flags, backwards, fresh);
+}
+
+#define BATCH_MAX_READ(nut) ((nut)->max_distance * 32)
+
+static int batch_needs_seek(nut_context_tt * nut, int stream, uint64_t pts, int * need) {
+	// reading on is cheaper than a seek if a known syncpoint past pts is close enough
+	syncpoint_list_tt * sl = &nut->syncpoints;
+	int i, err = 0;
+	if (nut->dopts.cache_syncpoints & 1) CHECK(flush_syncpoint_queue(nut));
+	i = first_syncpoint_after(nut, NULL, stream, pts);
+	*need = i == sl->len || sl->s[i].pos - bctello(nut->i) > BATCH_MAX_READ(nut);
+
+	// a seek is cheap too if it is known to land on a keyframe after the current position
+	if (!*need && (nut->dopts.cache_syncpoints & 1) && sl->keys[stream].len) {
+		sparse_list_tt * l = &sl->keys[stream];
+		int first = sparse_find(l, 1), j;
+		CHECK(build_seek_bounds(nut));
+		j = first_above(sl->bounds[stream].key_lo, first, l->len, pts + 1); // all pts are off-by-one
+		if (j > first && sl->s[l->e[j-1].sp - 1].pos > bctello(nut->i)) *need = 1;
+	}
+err_out:
+	return err;
+}
+
+int nut_seek_batch(nut_context_tt * nut, int stream, const uint64_t * pts, int count, nut_keyframe_tt * res) {
+	int active[2] = { stream, -1 };
+	nut_packet_tt pd, key;
+	off_t pd_syncpoint = 0, key_syncpoint = 0;
+	int i, err = 0, reading = 0, pending = 0, have_key = 0, eof = 0;
+
+	if (stream < 0 || stream >= nut->stream_count) return NUT_ERR_GENERAL_ERROR;
+
+	for (i = 0; i < count; i++) {
+		int need = !reading;
+		if (!need && !eof) CHECK(batch_needs_seek(nut, stream, pts[i], &need));
+		if (need) {
+			err = nut_seek_pts(nut, stream, pts[i], 0, active);
+			if (err == NUT_ERR_EOF) { // after the last syncpoint, read on from it to the end
+				syncpoint_list_tt * sl = &nut->syncpoints;
+				int j = sl->len - 1;
+				while (j && sl->s[j].pts_unknown) j--;
+				TO_PTS(tmp, sl->s[j].pts)
+				err = nut_seek_pts(nut, stream, convert_ts(tmp_p, nut->tb[tmp_tb], TO_TB(stream)), 0, active);
+			}
+			CHECK(err);
+			reading = 1;
+			pending = have_key = eof = 0;
+		}
+		// the last keyframe at or before pts[i], or the first one after it if there is none
+		for (;;) {
+			if (!pending) {
+				const uint8_t * buf;
+				if ((err = nut_read_next_packet(nut, &pd))) break;
+				if ((err = nut_read_frame_ref(nut, pd.len, &buf))) break;
+				if (pd.stream != stream) continue;
+				pd_syncpoint = nut->last_syncpoint;
+				pending = 1;
+			}
+			if (pd.pts > pts[i] && have_key) break; // stays pending for the next target
+			pending = 0;
+			if (!(pd.flags & NUT_FLAG_KEY)) continue;
+			if (pd.flags & NUT_FLAG_EOR) { // the stream ended there, like linear_search_seek() has it
+				if (pd.pts <= pts[i]) have_key = 0;
+				continue;
+			}
+			key = pd;
+			key_syncpoint = pd_syncpoint;
+			have_key = 1;
+			if (pd.pts > pts[i]) break;
+		}
+		if (err == NUT_ERR_EOF && have_key) {
+			eof = 1; // so are all the later targets
+			err = 0;
+		}
+		CHECK(err);
+		res[i].pd = key;
+		res[i].syncpoint = key_syncpoint;
+	}
+err_out:
 	return err;
 }
 
@@ -1526,13 +2547,21 @@ nut_context_tt * nut_demuxer_init(nut_demuxer_opts_tt * dopts) {
 	nut->syncpoints.len = 0;
 	nut->syncpoints.alloc_len = 0;
 	nut->syncpoints.s = NULL;
-	nut->syncpoints.pts = NULL;
+	nut->syncpoints.keys = NULL;
 	nut->syncpoints.eor = NULL;
-	nut->syncpoints.cached_pos = 0;
 	nut->syncpoints.linked = NULL;
+	nut->syncpoints.bounds = NULL;
+	nut->syncpoints.bounds_valid = 0;
+	nut->syncpoints.bounds_bytes = 0;
+	nut->syncpoints.linked_bytes = 0;
+	nut->syncpoints.inside = 0;
+	nut->syncpoints.shared = 0;
+	nut->shared = NULL;
 
 	nut->sc = NULL;
+	nut->stream_stats = NULL;
 	nut->tb = NULL;
+	nut->seek_pts = NULL;
 	nut->info = NULL;
 	nut->tmp_buffer = NULL; // the caller's allocated stream list
 	nut->last_headers = 0;
@@ -1541,9 +2570,14 @@ nut_context_tt * nut_demuxer_init(nut_demuxer_opts_tt * dopts) {
 	nut->dopts = *dopts;
 	nut->seek_status = 0;
 	nut->before_seek = 0;
+	nut->max_dts_stream = -1;
 	nut->binary_guess = 0;
+	nut->seek_expand = 0;
 	nut->last_syncpoint = 0;
 	nut->find_syncpoint_state = (struct find_syncpoint_state_s){0,0,0,0};
+	memset(&nut->stats, 0, sizeof(nut_stats_tt));
+	memset(&nut->memory, 0, sizeof(nut_memory_tt));
+	nut->o = NULL;
 
 	nut->alloc = &nut->dopts.alloc;
 
@@ -1568,36 +2602,386 @@ nut_context_tt * nut_demuxer_init(nut_demuxer_opts_tt * dopts) {
 		nut->dopts.read_index = 0;
 	}
 	if (nut->dopts.read_index) nut->dopts.cache_syncpoints = 1;
+	if (nut->dopts.mmap_input) map_input_buffer(nut->i);
+	if (nut->dopts.prefetch > 0 && !nut->i->map) nut->i->prefetch = prefetch_init(nut->alloc, &nut->i->isc, nut->dopts.prefetch);
+
+	switch (nut->dopts.checksums) {
+		case NUT_CHECKSUM_DEFERRED:
+			if ((nut->i->verify = verify_init(nut->alloc))) nut->i->checksums = NUT_CHECKSUM_DEFERRED;
+			break;
+		case NUT_CHECKSUM_TRUSTED:
+			nut->i->checksums = NUT_CHECKSUM_TRUSTED;
+			break;
+	}
+
+	nut->i->read_ahead = nut->i->read_ahead_min = MAX(nut->dopts.read_ahead, 0);
+	nut->i->read_ahead_max = MAX(nut->dopts.read_ahead_max, 0);
+	nut->i->read_ahead_align = MAX(nut->dopts.read_ahead_align, 0);
+	if (nut->i->read_ahead_max && !nut->i->read_ahead) nut->i->read_ahead = nut->i->read_ahead_min = PREALLOC_SIZE;
 
 	return nut;
 }
 
+static int share_headers(nut_context_tt * nut) {
+	// hands what nut_read_headers() found over to nut->shared, nut keeps using it from there
+	shared_headers_tt * hd = NULL;
+	int i, err = 0;
+	if (nut->shared) return 0;
+	ERROR(!nut->i || !nut->sc || !nut->syncpoints.len, NUT_ERR_NO_HEADERS);
+	CHECK(flush_syncpoint_queue(nut));
+	CHECK(build_seek_bounds(nut)); // the shared list can not build them later
+
+	SAFE_CALLOC(nut->alloc, hd, sizeof(shared_headers_tt), 1);
+	SAFE_CALLOC(nut->alloc, hd->sc, sizeof(stream_context_tt), nut->stream_count);
+	pthread_mutex_init(&hd->lock, NULL);
+	hd->refs = 1;
+	hd->alloc = *nut->alloc;
+	hd->timebase_count = nut->timebase_count;
+	hd->tb = nut->tb;
+	hd->stream_count = nut->stream_count;
+	for (i = 0; i < nut->stream_count; i++) {
+		hd->sc[i].sh = nut->sc[i].sh;
+		hd->sc[i].timebase_id = nut->sc[i].timebase_id;
+		hd->sc[i].msb_pts_shift = nut->sc[i].msb_pts_shift;
+		hd->sc[i].max_pts_distance = nut->sc[i].max_pts_distance;
+	}
+	hd->info_count = nut->info_count;
+	hd->info = nut->info;
+	hd->max_distance = nut->max_distance;
+	memcpy(hd->ft, nut->ft, sizeof(nut->ft));
+	hd->last_headers = nut->last_headers;
+	hd->syncpoints = nut->syncpoints;
+
+	nut->shared = hd;
+	nut->syncpoints.shared = 1;
+	return 0;
+err_out:
+	if (hd) nut->alloc->free(hd->sc);
+	nut->alloc->free(hd);
+	return err;
+}
+
+static void release_shared(shared_headers_tt * hd) {
+	int i, last;
+	pthread_mutex_lock(&hd->lock);
+	last = !--hd->refs;
+	pthread_mutex_unlock(&hd->lock);
+	if (!last) return;
+	for (i = 0; i < hd->stream_count; i++) {
+		hd->alloc.free(hd->sc[i].sh.fourcc);
+		hd->alloc.free(hd->sc[i].sh.codec_specific);
+	}
+	for (i = 0; i < hd->info_count; i++) free_info_packet(&hd->alloc, &hd->info[i]);
+	free_syncpoints(&hd->alloc, &hd->syncpoints, hd->stream_count);
+	hd->alloc.free(hd->sc);
+	hd->alloc.free(hd->info);
+	hd->alloc.free(hd->tb);
+	pthread_mutex_destroy(&hd->lock);
+	hd->alloc.free(hd);
+}
+
+static int use_shared(nut_context_tt * nut, shared_headers_tt * hd) {
+	int i, err = 0;
+
+	nut->shared = hd;
+	pthread_mutex_lock(&hd->lock);
+	hd->refs++;
+	pthread_mutex_unlock(&hd->lock);
+
+	nut->timebase_count = hd->timebase_count;
+	nut->tb = hd->tb;
+	nut->info_count = hd->info_count;
+	nut->info = hd->info;
+	nut->max_distance = hd->max_distance;
+	memcpy(nut->ft, hd->ft, sizeof(nut->ft)); // read for every frame, not worth an indirection
+	SAFE_CALLOC(nut->alloc, nut->seek_pts, sizeof(uint64_t), nut->timebase_count);
+	SAFE_CALLOC(nut->alloc, nut->sc, sizeof(stream_context_tt), hd->stream_count);
+	SAFE_CALLOC(nut->alloc, nut->stream_stats, sizeof(nut_stream_stats_tt), hd->stream_count);
+	nut->stats.streams = nut->stream_stats;
+	nut->stream_count = hd->stream_count;
+	for (i = 0; i < nut->stream_count; i++) {
+		stream_context_tt * sc = &nut->sc[i];
+		int j;
+		sc->sh = hd->sc[i].sh;
+		sc->timebase_id = hd->sc[i].timebase_id;
+		sc->msb_pts_shift = hd->sc[i].msb_pts_shift;
+		sc->max_pts_distance = hd->sc[i].max_pts_distance;
+		SAFE_CALLOC(nut->alloc, sc->pts_cache, sizeof(int64_t), sc->sh.decode_delay);
+		for (j = 0; j < sc->sh.decode_delay; j++) sc->pts_cache[j] = -1;
+	}
+
+	nut->syncpoints = hd->syncpoints;
+	nut->syncpoints.inside = 0;
+	nut->syncpoints.shared = 1;
+	if (nut->i->isc.seek) nut->dopts.cache_syncpoints = 1; // the shared syncpoints cost nothing to use
+err_out:
+	return err;
+}
+
+nut_context_tt * nut_demuxer_init_shared(nut_demuxer_opts_tt * dopts, nut_context_tt * master) {
+	nut_context_tt * nut;
+
+	if (share_headers(master)) return NULL;
+	if (!(nut = nut_demuxer_init(dopts))) return NULL;
+	if (use_shared(nut, master->shared)) {
+		nut_demuxer_uninit(nut);
+		return NULL;
+	}
+	return nut;
+}
+
 void nut_demuxer_uninit(nut_context_tt * nut) {
 	int i;
 	if (!nut) return;
 	for (i = 0; i < nut->stream_count; i++) {
-		nut->alloc->free(nut->sc[i].sh.fourcc);
-		nut->alloc->free(nut->sc[i].sh.codec_specific);
+		if (!nut->shared) {
+			nut->alloc->free(nut->sc[i].sh.fourcc);
+			nut->alloc->free(nut->sc[i].sh.codec_specific);
+		}
 		nut->alloc->free(nut->sc[i].pts_cache);
 	}
-	for (i = 0; i < nut->info_count; i++) free_info_packet(nut, &nut->info[i]);
+	for (i = 0; !nut->shared && i < nut->info_count; i++) free_info_packet(nut->alloc, &nut->info[i]);
 
-	nut->alloc->free(nut->syncpoints.s);
-	nut->alloc->free(nut->syncpoints.pts);
-	nut->alloc->free(nut->syncpoints.eor);
+	if (!nut->syncpoints.shared) free_syncpoints(nut->alloc, &nut->syncpoints, nut->stream_count);
 	while (nut->syncpoints.linked) {
 		syncpoint_linked_tt * s = nut->syncpoints.linked;
 		nut->syncpoints.linked = s->prev;
 		nut->alloc->free(s);
 	}
 	nut->alloc->free(nut->sc);
+	nut->alloc->free(nut->stream_stats);
 	nut->alloc->free(nut->tmp_buffer); // the caller's allocated stream list
-	nut->alloc->free(nut->info);
-	nut->alloc->free(nut->tb);
+	if (nut->shared) release_shared(nut->shared);
+	else {
+		nut->alloc->free(nut->info);
+		nut->alloc->free(nut->tb);
+	}
+	nut->alloc->free(nut->seek_pts);
+	if (nut->i->verify) {
+		verify_sync(nut->i->verify);
+		report_checksums(nut);
+	}
 	free_buffer(nut->i);
 	nut->alloc->free(nut);
 }
 
+static void cache_key(nut_context_tt * nut, uint64_t * size, uint64_t * mtime) {
+	struct stat st;
+	*size = nut->i->filesize; // only known after reading the index or a seek
+	*mtime = 0;
+	if (!nut->dopts.input.read && !fstat(fileno(nut->dopts.input.priv), &st)) {
+		*size = st.st_size;
+		*mtime = (uint64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+	}
+}
+
+static uint8_t * put_cache_v(uint8_t * p, uint64_t val) {
+	int i;
+	for (i = 7; i < 64 && val >> i; i += 7);
+	for (i -= 7; i > 0; i -= 7) *p++ = 0x80 | (val >> i);
+	*p++ = val & 0x7F;
+	return p;
+}
+
+int nut_write_syncpoint_cache(nut_context_tt * nut, nut_output_stream_tt * out) {
+	syncpoint_list_tt * sl = &nut->syncpoints;
+	uint8_t * buf = NULL, * p;
+	uint64_t size, mtime;
+	uint32_t crc;
+	size_t len;
+	int i, j, err = 0;
+
+	ERROR(!nut->sc, NUT_ERR_NO_HEADERS);
+	CHECK(flush_syncpoint_queue(nut));
+	drop_inside_syncpoints(nut);
+	cache_key(nut, &size, &mtime);
+
+	len = 8 + 5 * 10 + sl->len * 4 * 10 + 4; // every v is at most 10 bytes
+	for (i = 0; i < nut->stream_count; i++) len += (2 + 2 * (sl->keys[i].len + sl->eor[i].len)) * 10;
+	ERROR(!(buf = nut->alloc->malloc(len)), NUT_ERR_OUT_OF_MEM);
+
+	p = buf;
+	for (i = 8; i--; ) *p++ = CACHE_STARTCODE >> (i * 8);
+	p = put_cache_v(p, CACHE_VERSION);
+	p = put_cache_v(p, size);
+	p = put_cache_v(p, mtime);
+	p = put_cache_v(p, nut->stream_count);
+	p = put_cache_v(p, sl->len);
+	for (i = 0; i < sl->len; i++) {
+		p = put_cache_v(p, sl->s[i].pos - (i ? sl->s[i-1].pos : 0));
+		p = put_cache_v(p, sl->s[i].pts);
+		p = put_cache_v(p, sl->s[i].back_ptr);
+		p = put_cache_v(p, sl->s[i].seen_next | sl->s[i].pts_valid << 1 | sl->s[i].pts_unknown << 2 | sl->s[i].merged << 3);
+	}
+	for (i = 0; i < nut->stream_count * 2; i++) {
+		sparse_list_tt * l = i < nut->stream_count ? &sl->keys[i] : &sl->eor[i - nut->stream_count];
+		p = put_cache_v(p, l->len);
+		for (j = 0; j < l->len; j++) {
+			p = put_cache_v(p, l->e[j].sp - (j ? l->e[j-1].sp : 0));
+			p = put_cache_v(p, l->e[j].pts);
+		}
+	}
+	crc = nut_crc32(buf, p - buf);
+	for (i = 4; i--; ) *p++ = crc >> (i * 8);
+
+	len = p - buf;
+	if (out->write) ERROR(out->write(out->priv, len, buf) != len, NUT_ERR_GENERAL_ERROR);
+	else ERROR(fwrite(buf, 1, len, out->priv) != len, NUT_ERR_GENERAL_ERROR);
+err_out:
+	nut->alloc->free(buf);
+	return err;
+}
+
+int nut_read_syncpoint_cache(nut_context_tt * nut, nut_input_stream_tt * in) {
+	syncpoint_list_tt * sl = &nut->syncpoints;
+	input_buffer_tt itmp, * tmp = new_mem_buffer(&itmp);
+	syncpoint_tt * s = NULL;
+	sparse_list_tt * lists = NULL;
+	uint8_t * buf = NULL;
+	size_t len = 0, alloc_len = 0, got;
+	uint64_t size, mtime, x;
+	int i, j, n = 0, err = 0;
+
+	ERROR(!nut->sc, NUT_ERR_NO_HEADERS);
+	if (!(nut->dopts.cache_syncpoints & 1)) return 0;
+
+	do {
+		if (len == alloc_len) {
+			alloc_len = alloc_len * 2 + PREALLOC_SIZE;
+			SAFE_REALLOC(nut->alloc, buf, 1, alloc_len);
+		}
+		if (in->read) got = in->read(in->priv, alloc_len - len, buf + len);
+		else got = fread(buf + len, 1, alloc_len - len, in->priv);
+		len += got;
+	} while (got);
+
+	ERROR(len < 12, NUT_ERR_CACHE_MISMATCH);
+	ERROR(nut_crc32(buf, len), NUT_ERR_BAD_CHECKSUM);
+	tmp->buf_ptr = tmp->buf = buf;
+	tmp->write_len = tmp->read_len = len - 4;
+
+	cache_key(nut, &size, &mtime);
+	CHECK(get_bytes(tmp, 8, &x));
+	ERROR(x != CACHE_STARTCODE, NUT_ERR_CACHE_MISMATCH);
+	GET_V(tmp, x);
+	ERROR(x != CACHE_VERSION, NUT_ERR_CACHE_MISMATCH);
+	GET_V(tmp, x);
+	ERROR(x != size || !size, NUT_ERR_CACHE_MISMATCH);
+	GET_V(tmp, x);
+	ERROR(x != mtime, NUT_ERR_CACHE_MISMATCH);
+	GET_V(tmp, x);
+	ERROR(x != nut->stream_count, NUT_ERR_CACHE_MISMATCH);
+
+	// everything is loaded aside first, the current cache stays if anything is wrong
+	GET_V(tmp, x);
+	ERROR(!x || x > len / 4, NUT_ERR_GENERAL_ERROR);
+	n = x;
+	SAFE_CALLOC(nut->alloc, s, sizeof(syncpoint_tt), n);
+	for (i = 0; i < n; i++) {
+		GET_V(tmp, x);
+		ERROR(i && !x, NUT_ERR_GENERAL_ERROR);
+		s[i].pos = x + (i ? s[i-1].pos : 0);
+		GET_V(tmp, s[i].pts);
+		GET_V(tmp, x);
+		s[i].back_ptr = x;
+		GET_V(tmp, x);
+		s[i].seen_next = x & 1;
+		s[i].pts_valid = (x >> 1) & 1;
+		s[i].pts_unknown = (x >> 2) & 1;
+		s[i].merged = (x >> 3) & 1;
+	}
+
+	SAFE_CALLOC(nut->alloc, lists, sizeof(sparse_list_tt), nut->stream_count * 2);
+	for (i = 0; i < nut->stream_count * 2; i++) {
+		sparse_list_tt * l = &lists[i];
+		GET_V(tmp, x);
+		ERROR(x > n, NUT_ERR_GENERAL_ERROR);
+		if (!x) continue;
+		l->len = l->alloc_len = x;
+		SAFE_CALLOC(nut->alloc, l->e, sizeof(sparse_pts_tt), l->len);
+		for (j = 0; j < l->len; j++) {
+			GET_V(tmp, x);
+			ERROR((j && !x) || x + (j ? l->e[j-1].sp : 0) >= n, NUT_ERR_GENERAL_ERROR);
+			l->e[j].sp = x + (j ? l->e[j-1].sp : 0);
+			GET_V(tmp, l->e[j].pts);
+			ERROR(!l->e[j].pts, NUT_ERR_GENERAL_ERROR);
+		}
+	}
+
+	CHECK(unshare_syncpoints(nut)); // the shared lists cannot be freed
+	for (i = 0; i < nut->stream_count; i++) {
+		nut->alloc->free(sl->keys[i].e);
+		nut->alloc->free(sl->eor[i].e);
+		sl->keys[i] = lists[i];
+		sl->eor[i] = lists[i + nut->stream_count];
+	}
+	sl->bounds_valid = 0;
+	nut->alloc->free(lists);
+	lists = NULL;
+	nut->alloc->free(sl->s);
+	sl->s = s;
+	sl->len = sl->alloc_len = n;
+	sl->inside = 0;
+	s = NULL;
+
+	// syncpoints found since nut_read_headers() are kept
+	CHECK(flush_syncpoint_queue(nut));
+	CHECK(check_memory(nut));
+err_out:
+	for (i = 0; lists && i < nut->stream_count * 2; i++) nut->alloc->free(lists[i].e);
+	nut->alloc->free(lists);
+	nut->alloc->free(s);
+	nut->alloc->free(buf);
+	return err;
+}
+
+int nut_scan_index(nut_context_tt * nut, off_t start, off_t end, nut_index_tt * index) {
+	syncpoint_list_tt * sl = &nut->syncpoints;
+	int cache_syncpoints = nut->dopts.cache_syncpoints;
+	nut_packet_tt pd;
+	int i, j, n, first, err = 0;
+
+	report_checksums(nut);
+	if (!index->max_pts) SAFE_CALLOC(nut->alloc, index->max_pts, sizeof(uint64_t), nut->stream_count);
+	CHECK(flush_syncpoint_queue(nut));
+	nut->dopts.cache_syncpoints = 3; // syncpoints go into the cache right away, with their keyframes
+
+	if (start > bctello(nut->i) && !nut->seek_status) {
+		seek_buf(nut->i, start, SEEK_SET);
+		nut->seek_status = 1; // read_packet() finds the next syncpoint, as after an error
+	}
+	for (;;) {
+		if (nut->i->buf_ptr != nut->i->buf) flush_buf(nut->i);
+		if ((err = read_packet(nut, &pd))) break;
+		if (end && nut->last_syncpoint >= end) break; // the next part's
+		if ((err = skip_buffer(nut->i, pd.len))) break;
+		push_frame(nut, &pd);
+		index->max_pts[pd.stream] = MAX(index->max_pts[pd.stream], pd.pts);
+		index->data_end = bctello(nut->i);
+		index->frames++;
+	}
+	nut->i->buf_ptr = nut->i->buf; // rewind, the packet was not taken
+	if (err == NUT_ERR_EOF) err = 0;
+	CHECK(err);
+
+	first = syncpoint_index(sl->s, sl->len, start - 1) + 1;
+	n = sl->len - first;
+	SAFE_CALLOC(nut->alloc, index->pos, sizeof(off_t), n + 1);
+	SAFE_CALLOC(nut->alloc, index->keys, sizeof(uint64_t), n * nut->stream_count + 1);
+	SAFE_CALLOC(nut->alloc, index->eor, sizeof(uint64_t), n * nut->stream_count + 1);
+	index->len = n;
+	for (i = 0; i < n; i++) {
+		index->pos[i] = sl->s[first + i].pos;
+		for (j = 0; j < nut->stream_count; j++) {
+			index->keys[i * nut->stream_count + j] = sparse_get(&sl->keys[j], first + i);
+			index->eor[i * nut->stream_count + j] = sparse_get(&sl->eor[j], first + i);
+		}
+	}
+err_out:
+	nut->dopts.cache_syncpoints = cache_syncpoints;
+	return err;
+}
+
 const char * nut_error(int error) {
 	switch((enum nut_errors)error) {
 		case NUT_ERR_NO_ERROR: return "No error.";
@@ -1618,6 +3002,13 @@ const char * nut_error(int error) {
 		case NUT_ERR_BAD_EOF: return "Invalid forward_ptr!";
 		case NUT_ERR_VLC_TOO_LONG: return "VLC too long";
 		case NUT_ERR_OUT_OF_MEM: return "Out of memory";
+		case NUT_ERR_CACHE_MISMATCH: return "Syncpoint cache is for another file.";
 	}
 	return NULL;
 }
+
+void nut_get_stats(nut_context_tt * nut, nut_stats_tt * stats) {
+	*stats = nut->stats;
+	if (nut->i) stats->buffer_high_water = nut->i->map ? 0 : nut->i->write_len;
+	else stats->buffer_high_water = nut->o->write_len;
+}
@@ -103,6 +103,62 @@ typedef struct {
 	int64_t next_pts; ///< Only used in muxer. Only necessary if nut_write_frame_reorder() is used.
 } nut_packet_tt;
 
+/// per stream counters in nut_stats_tt \ingroup demuxer muxer
+typedef struct {
+	uint64_t frames;          ///< frames written or demuxed
+	uint64_t bytes;           ///< frame data, without headers
+	uint64_t header_bytes;    ///< frame headers, framecode byte included
+	uint64_t checksum_frames; ///< Frames whose header needed FLAG_CHECKSUM, because of their size or pts jump.
+	uint64_t coded_frames;    ///< Frames whose header needed FLAG_CODED, no framecode fit them.
+} nut_stream_stats_tt;
+
+/// counters of a muxer or demuxer context, given by nut_get_stats() \ingroup demuxer muxer
+typedef struct {
+	const nut_stream_stats_tt * streams; ///< One per stream, NULL until the demuxer has read the headers.
+	uint64_t syncpoints;        ///< syncpoints written or passed by demuxing
+	uint64_t syncpoint_bytes;   ///< syncpoint packets, startcode and checksum included
+	uint64_t index_bytes;       ///< index packet, startcode and checksum included
+	uint64_t header_bytes;      ///< main, stream and info headers including repetitions
+	uint64_t resyncs;           ///< Demuxer only, times it searched for a syncpoint after an error in the file.
+	int buffer_high_water;      ///< Largest size of the input or output buffer in bytes, 0 for memory mapped input.
+	int reorder_high_water;     ///< Muxer only, most frames nut_write_frame_reorder() held back at once.
+} nut_stats_tt;
+
+/// Gives the counters of a muxer or demuxer context. nut_stats_tt::streams stays valid until the context is freed.
+void nut_get_stats(nut_context_tt * nut, nut_stats_tt * stats);
+
+/// memory categories in nut_memory_tt \ingroup demuxer muxer
+enum nut_memory_category_tt {
+	NUT_MEM_SYNCPOINTS = 0, ///< syncpoint cache, an index is read straight into it
+	NUT_MEM_BUFFERS    = 1, ///< input buffer and prefetch blocks, or the muxer's output buffers
+	NUT_MEM_REORDER    = 2, ///< frames held back by nut_write_frame_reorder()
+	NUT_MEM_HEADERS    = 3, ///< stream contexts, stream headers and info packets
+	NUT_MEM_CATEGORIES = 4, ///< number of categories
+};
+
+/// memory used by a muxer or demuxer context, given by nut_get_memory() \ingroup demuxer muxer
+typedef struct {
+	size_t current[NUT_MEM_CATEGORIES]; ///< bytes held now, by category
+	size_t peak[NUT_MEM_CATEGORIES];    ///< Most bytes held, by category. Sampled at syncpoints, after seeks and in nut_get_memory(), so a peak between two samples is missed.
+	size_t total;                       ///< sum of #current
+	size_t total_peak;                  ///< highest #total in the same samples as #peak
+	int thinned;                        ///< Times the syncpoint cache was thinned out to stay under nut_demuxer_opts_tt::memory_limit.
+} nut_memory_tt;
+
+/// Gives the memory used by a muxer or demuxer context, by category. Small fixed allocations and what nut_demuxer_init_shared() shares are not counted.
+void nut_get_memory(nut_context_tt * nut, nut_memory_tt * mem);
+
+/// syncpoints of a file with the keyframes before each one, given by nut_scan_index() and written by nut_write_index() \ingroup demuxer muxer
+typedef struct {
+	int len;            ///< number of syncpoints
+	off_t * pos;        ///< Positions of the syncpoints in the file, has #len elements.
+	uint64_t * keys;    ///< Has #len * stream_count elements, stream \a j of syncpoint \a i at [i * stream_count + j]. pts + 1 of the first keyframe between the syncpoint before and this one, 0 if none.
+	uint64_t * eor;     ///< Laid out like #keys, pts + 1 of the EOR frame if the stream ended in that region, 0 otherwise.
+	uint64_t * max_pts; ///< highest pts of every stream, has stream_count elements
+	int frames;         ///< frames read by nut_scan_index()
+	off_t data_end;     ///< End of the last complete frame nut_scan_index() read, 0 if none.
+} nut_index_tt;
+
 
 
 /*****************************************
@@ -158,6 +214,9 @@ void nut_muxer_uninit_reorder(nut_context_tt * nut);
 
 /// Creates an optimized framecode table for the NUT main header based on stream info.
 void nut_framecode_generate(const nut_stream_header_tt s[], nut_frame_table_input_tt fti[256]);
+
+/// Writes the headers of a context followed by an index of \a index, what nut_muxer_uninit() ends a file with.
+int nut_write_index(nut_context_tt * nut, const nut_index_tt * index, nut_output_stream_tt * out);
 /// @}
 
 
@@ -176,25 +235,59 @@ typedef struct {
 	off_t (*seek)(void * priv, long long pos, int whence);  ///< Input stream seek function, must return position in file after seek.
 	int (*eof)(void * priv);                                ///< Returns if EOF has been met in stream in case of read error.
 	off_t file_pos;                                         ///< file position at beginning of read
+	void (*hint)(void * priv, off_t pos, size_t len);       ///< Optional, announces an area of the file that is likely to be read soon.
 } nut_input_stream_tt;
 
+/// checksum verification policies for nut_demuxer_opts_tt::checksums
+enum nut_checksum_tt {
+	NUT_CHECKSUM_STRICT   = 0, ///< Checked while demuxing, a bad checksum is an error like any other.
+	NUT_CHECKSUM_DEFERRED = 1, ///< Checked by a worker thread, failures are given to nut_demuxer_opts_tt::bad_checksum.
+	NUT_CHECKSUM_TRUSTED  = 2, ///< Not checked, for input that was already verified.
+};
+
+/// what the last nut_seek() did, filled in if nut_demuxer_opts_tt::seek_trace is set
+typedef struct {
+	int seeks;               ///< Calls that reached nut_input_stream_tt::seek.
+	off_t bytes_read;        ///< Bytes read from the input, or brought into the window when memory mapped.
+	int used_index;          ///< 1 if the index or syncpoint cache gave the area to search, 0 if it was found by binary search.
+	int probes;              ///< Binary search iterations, each probing one interpolated guess.
+	int missed_guesses;      ///< Probes that found no new syncpoint after the guess and had to scan backwards.
+	off_t scan_bytes;        ///< Bytes of packets walked by the linear search.
+} nut_seek_trace_tt;
+
 /// demuxer options struct
 typedef struct {
 	nut_input_stream_tt input;  ///< input stream function pointers
 	nut_alloc_tt alloc;         ///< memory allocation function pointers
 	int read_index;            ///< Seeks to end-of-file at beginning of playback to search for index. Implies cache_syncpoints.
 	int cache_syncpoints;      ///< Improves seekability and error recovery greatly, but costs some memory (0.5MB for very large files).
+	int mmap_input;            ///< Memory maps the input file instead of copying it through a buffer. Only used if nut_input_stream_tt::read is NULL.
+	int read_ahead;            ///< Minimum amount of bytes asked from nut_input_stream_tt::read() at once. Zero reads only what is needed.
+	int read_ahead_align;      ///< If non-zero, reads are extended to end on a multiple of this many bytes in the file.
+	int read_ahead_max;        ///< If higher than #read_ahead, read-ahead doubles up to this value during sequential reading.
+	int prefetch;              ///< If non-zero, a background thread reads blocks of this many bytes ahead of the demuxer.
+	int checksums;             ///< How checksums are verified, one of enum ::nut_checksum_tt.
+	void * checksum_priv;      ///< opaque priv pointer to be passed to #bad_checksum
+	void (*bad_checksum)(void * priv, off_t pos); ///< Called with the position of every checksum that failed in #NUT_CHECKSUM_DEFERRED mode. May be NULL.
 	void * info_priv;          ///< opaque priv pointer to be passed to #new_info
 	void (*new_info)(void * priv, nut_info_packet_tt * info); ///< Function to be called when info is found mid-stream. May be NULL.
+	nut_seek_trace_tt * seek_trace; ///< If non-NULL, cleared at the start of every seek and filled while it runs. May be NULL.
+	size_t memory_limit;       ///< If non-zero, the syncpoint cache is thinned out whenever the context grows past this many bytes. Seeks land where they would without it, but read the thinned out regions of the file again. Other memory is never given back for it.
 } nut_demuxer_opts_tt;
 
+/// keyframe found by nut_seek_batch()
+typedef struct {
+	nut_packet_tt pd;   ///< frame header, as nut_read_next_packet() gave it
+	off_t syncpoint;    ///< position of the syncpoint before the frame, where demuxing it starts
+} nut_keyframe_tt;
+
 /// Possible errors given from demuxer functions. Only the first 4 errors should ever be returned, the rest are internal.
 enum nut_errors {
 	NUT_ERR_NO_ERROR      = 0,    ///< = 0
 	NUT_ERR_EOF           = 1,    ///< = 1
 	NUT_ERR_EAGAIN        = 2,    ///< = 2
 	NUT_ERR_OUT_OF_MEM    = 3,    ///< = 3
-	NUT_ERR_NOT_SEEKABLE,         ///< Can only be returned by nut_seek(). Indicates that the seek was unsuccessful.
+	NUT_ERR_NOT_SEEKABLE,         ///< Can only be returned by nut_seek() and nut_seek_pts(). Indicates that the seek was unsuccessful.
 	NUT_ERR_GENERAL_ERROR,
 	NUT_ERR_BAD_VERSION,
 	NUT_ERR_NOT_FRAME_NOT_N,
@@ -208,11 +301,15 @@ enum nut_errors {
 	NUT_ERR_BAD_STREAM_ORDER,
 	NUT_ERR_NOSTREAM_STARTCODE,
 	NUT_ERR_BAD_EOF,
+	NUT_ERR_CACHE_MISMATCH,       ///< Can only be returned by nut_read_syncpoint_cache(). Indicates that the cache was written for another file.
 };
 
 /// Creates a NUT demuxer context. Does not read any information from file.
 nut_context_tt * nut_demuxer_init(nut_demuxer_opts_tt * dopts);
 
+/// Creates a NUT demuxer context for the same file as \a master, using its headers and index instead of reading them again.
+nut_context_tt * nut_demuxer_init_shared(nut_demuxer_opts_tt * dopts, nut_context_tt * master);
+
 /// Frees a NUT demuxer context. No other functions can be called after this.
 void nut_demuxer_uninit(nut_context_tt * nut);
 
@@ -225,11 +322,32 @@ int nut_read_next_packet(nut_context_tt * nut, nut_packet_tt * pd);
 /// Reads just the frame \b data, not the header.
 int nut_read_frame(nut_context_tt * nut, int * len, uint8_t * buf);
 
+/// Gives a pointer to the frame \b data in libnut's input buffer instead of copying it.
+int nut_read_frame_ref(nut_context_tt * nut, int len, const uint8_t ** buf);
+
+/// Gets up to \a max frame headers at once, together with pointers to their data in libnut's input buffer.
+int nut_read_packets(nut_context_tt * nut, nut_packet_tt * pd, const uint8_t ** data, int max, int * count);
+
 /// Gives human readable description of the error return code of any demuxing function.
 const char * nut_error(int error);
 
 /// Seeks to the requested position in seconds.
 int nut_seek(nut_context_tt * nut, double time_pos, int flags, const int * active_streams);
+
+/// Seeks to the requested pts in the timebase of a stream, without rounding through seconds.
+int nut_seek_pts(nut_context_tt * nut, int stream, int64_t pts, int flags, const int * active_streams);
+
+/// Finds the keyframe for each of a sorted list of pts in one forward pass, for thumbnails and previews.
+int nut_seek_batch(nut_context_tt * nut, int stream, const uint64_t * pts, int count, nut_keyframe_tt * res);
+
+/// Saves the syncpoint cache to a sidecar file, to be loaded by nut_read_syncpoint_cache() when the file is opened again.
+int nut_write_syncpoint_cache(nut_context_tt * nut, nut_output_stream_tt * out);
+
+/// Loads a syncpoint cache saved by nut_write_syncpoint_cache(), replacing what was found in the file so far.
+int nut_read_syncpoint_cache(nut_context_tt * nut, nut_input_stream_tt * in);
+
+/// Reads every frame of a part of the file and gives its syncpoints and keyframes, for writing an index with nut_write_index().
+int nut_scan_index(nut_context_tt * nut, off_t start, off_t end, nut_index_tt * index);
 /// @}
 
 
@@ -444,6 +562,24 @@ int nut_seek(nut_context_tt * nut, double time_pos, int flags, const int * activ
  * nut_muxer_opts_tt::fti is \a NULL.
  */
 
+/*! \fn int nut_write_index(nut_context_tt * nut, const nut_index_tt * index, nut_output_stream_tt * out)
+ * \param nut   NUT muxer context, or a demuxer context on which
+ *              nut_read_headers() has succeeded.
+ * \param index syncpoints to write, usually from nut_scan_index()
+ * \param out   Where to write. If nut_output_stream_tt::write is NULL,
+ *              nut_output_stream_tt::priv is used as FILE*.
+ *
+ * Writes the main and stream headers of \a nut, its info packets if
+ * nut_read_headers() was given \a info, and an index packet coded with
+ * its timebases. Appended right after the last complete frame of the file
+ * \a nut read, this gives a file without an index the same ending
+ * nut_muxer_uninit() gives one with nut_muxer_opts_tt::write_index.
+ * Nothing else of \a nut is changed.
+ *
+ * Returns #NUT_ERR_OUT_OF_MEM if the index could not be built, nothing
+ * is written to \a out then.
+ */
+
 /*! \addtogroup demuxer
  * All of the demuxer related functions return an integer value
  * representing one of the following return codes:
@@ -491,6 +627,53 @@ int nut_seek(nut_context_tt * nut, double time_pos, int flags, const int * activ
  * - SEEK_END - pos is used as offset from end of file
  */
 
+/*! \var int nut_demuxer_opts_tt::mmap_input
+ * If set, the whole file given as FILE* in nut_input_stream_tt::priv is
+ * mapped into memory, and headers and frames are parsed directly from the
+ * mapping without any copying of the input data.
+ *
+ * Silently ignored if nut_input_stream_tt::read is non-NULL or the file
+ * cannot be mapped (e.g. pipes). Data appended to the file after
+ * nut_demuxer_init() is not seen, so this should not be used for files
+ * which are still being written.
+ */
+
+/*! \var int nut_demuxer_opts_tt::read_ahead_max
+ * Adaptive read-ahead: every read from the input stream doubles the
+ * read-ahead window, up to #read_ahead_max bytes. Any seek in the input
+ * stream drops it back to #read_ahead, so seeking, which reads small
+ * scattered areas, does not pay for large reads.
+ *
+ * Input buffer memory use is about twice the largest window.
+ */
+
+/*! \var int nut_demuxer_opts_tt::prefetch
+ * Input is read by a worker thread into two blocks of #prefetch bytes,
+ * one is filled while the demuxer consumes the other. Seeking inside the
+ * buffered blocks keeps them, any other seek waits for the pending read
+ * and drops them.
+ *
+ * nut_input_stream_tt callbacks are then called from the worker thread
+ * as well, though never at the same time. Ignored if the input is memory
+ * mapped.
+ */
+
+/*! \var int nut_demuxer_opts_tt::checksums
+ * Applies to header and frame header checksums met while demuxing.
+ * Searching for headers and syncpoints always checks them, as that is
+ * how real startcodes are told apart from data that looks like one.
+ *
+ * With #NUT_CHECKSUM_DEFERRED, the checked bytes are copied to a queue
+ * unless the input is memory mapped, and demuxing goes on as if the
+ * checksum was correct. Failures found by the worker thread are given to
+ * nut_demuxer_opts_tt::bad_checksum on the demuxing thread, at the next
+ * call to nut_read_next_packet(), nut_read_packets() or nut_seek(), and
+ * at the latest in nut_demuxer_uninit(). nut_demuxer_opts_tt::alloc must
+ * be thread safe in this mode.
+ *
+ * Unknown values are treated as #NUT_CHECKSUM_STRICT.
+ */
+
 /*! \var int (*nut_input_stream_tt::eof)(void * priv)
  * Only necessary if stream supports non-blocking mode.
  * Returns non-zero if stream is at EOF, 0 otherwise.
@@ -508,6 +691,42 @@ int nut_seek(nut_context_tt * nut, double time_pos, int flags, const int * activ
  * usually be zero.
  */
 
+/*! \var void (*nut_input_stream_tt::hint)(void * priv, off_t pos, size_t len)
+ * May be NULL. Called by nut_seek() for areas it might scan next, several
+ * at a time before blocking on one of them, so a stream with asynchronous
+ * I/O can have all of them in flight at once. Never changes the stream
+ * position, and a hint that is not followed by a read is not an error.
+ *
+ * With a FILE* stream, this is posix_fadvise(POSIX_FADV_WILLNEED).
+ */
+
+/*! \fn nut_context_tt * nut_demuxer_init_shared(nut_demuxer_opts_tt * dopts, nut_context_tt * master)
+ * \param dopts  Options of the new context, nut_demuxer_opts_tt::input
+ *               must give the same file as the one of \a master.
+ * \param master Demuxer context on which nut_read_headers() has succeeded.
+ *
+ * For serving many readers of one file. The stream headers, info packets,
+ * frame code table and syncpoint cache of \a master are shared, read-only,
+ * by every context created from it, and freed by the last
+ * nut_demuxer_uninit() of any of them, \a master included. Each context
+ * has its own position in the file and its own state per stream.
+ *
+ * nut_read_headers() must still be called on the new context, but does not
+ * read anything from the file then. It gives the same headers as for
+ * \a master and playback starts at the first syncpoint. Syncpoints found
+ * later by a context go into a private copy of the cache, which is only
+ * made when a context finds one the shared cache does not know about,
+ * so it is best to call this after the index was read.
+ *
+ * Must not be called while \a master is used elsewhere, nor while a
+ * nut_seek() on it is being repeated for #NUT_ERR_EAGAIN. The contexts can
+ * then be used and freed from different threads.
+ * nut_demuxer_opts_tt::read_index is ignored, and
+ * nut_demuxer_opts_tt::cache_syncpoints is always set for seekable input.
+ *
+ * Returns NULL if \a master has no headers or on memory errors.
+ */
+
 /*! \fn int nut_read_headers(nut_context_tt * nut, nut_stream_header_tt * s [], nut_info_packet_tt * info [])
  * \param nut  NUT demuxer context
  * \param s    Pointer to stream header variable to be set to an array
@@ -566,6 +785,42 @@ int nut_seek(nut_context_tt * nut, double time_pos, int flags, const int * activ
  * \endcode
  */
 
+/*! \fn int nut_read_frame_ref(nut_context_tt * nut, int len, const uint8_t ** buf)
+ * \param nut NUT demuxer context
+ * \param len length of the frame, as given by nut_read_next_packet()
+ * \param buf pointer to be set to the frame data
+ *
+ * This function must be called \b after nut_read_next_packet(), in place
+ * of nut_read_frame().
+ *
+ * The frame data is not copied, \a buf points into libnut's own input
+ * buffer and stays valid only until the next call to any demuxer function
+ * with the same context. If the frame is bigger than what is currently
+ * buffered, the buffer is grown to hold all of it.
+ *
+ * If the function returns #NUT_ERR_EAGAIN, nothing is consumed and it
+ * should be called again with the same parameters.
+ */
+
+/*! \fn int nut_read_packets(nut_context_tt * nut, nut_packet_tt * pd, const uint8_t ** data, int max, int * count)
+ * \param nut   NUT demuxer context
+ * \param pd    array of at least \a max frame headers to be filled
+ * \param data  array of at least \a max pointers, set to the data of each frame
+ * \param max   maximum amount of frames to return
+ * \param count set to the amount of frames returned
+ *
+ * Same as calling nut_read_next_packet() and nut_read_frame_ref() in a loop,
+ * without flushing the input buffer between frames. Stops early at the
+ * first frame that can not be read entirely, it is then given again by the
+ * next call.
+ *
+ * The pointers in \a data point into libnut's input buffer and stay valid
+ * only until the next call to any demuxer function with the same context.
+ *
+ * Returns an error only if no frame could be read, otherwise the error is
+ * returned by the next call.
+ */
+
 /*! \fn int nut_seek(nut_context_tt * nut, double time_pos, int flags, const int * active_streams)
  * \param nut            NUT demuxer context
  * \param time_pos       position to seek to in seconds
@@ -591,7 +846,114 @@ int nut_seek(nut_context_tt * nut, double time_pos, int flags, const int * activ
  * If #NUT_ERR_EOF is returned, the requested position is outside the
  * bounds of the file.
  *
+ * If nut_demuxer_opts_tt::seek_trace is set, it describes the I/O and
+ * search work of the seek once the function returns anything but
+ * #NUT_ERR_EAGAIN.
+ *
  * After nut_seek, nut_read_next_packet should be called to get the next frame.
  */
 
+/*! \fn int nut_seek_pts(nut_context_tt * nut, int stream, int64_t pts, int flags, const int * active_streams)
+ * \param nut            NUT demuxer context
+ * \param stream         stream whose timebase \a pts is in
+ * \param pts            position to seek to
+ * \param flags          bitfield with seek options, as in nut_seek()
+ * \param active_streams List of all active streams terminated by -1,
+ *                       may be NULL indicating that all streams are active.
+ *
+ * Works exactly like nut_seek(), except for how the target is given.
+ * It is converted to the other timebases in integers, so frames with
+ * exactly the requested pts are found, even in long files with fine
+ * timebases.
+ *
+ * If \a stream does not exist, #NUT_ERR_GENERAL_ERROR is returned.
+ */
+
+/*! \fn int nut_seek_batch(nut_context_tt * nut, int stream, const uint64_t * pts, int count, nut_keyframe_tt * res)
+ * \param nut    NUT demuxer context
+ * \param stream stream to find keyframes of, \a pts are in its timebase
+ * \param pts    targets, sorted in ascending order
+ * \param count  number of targets
+ * \param res    filled with one keyframe per target
+ *
+ * For every target, finds the last keyframe of \a stream at or before
+ * it, or the first one after it if there is none. Frame data is skipped,
+ * a keyframe can then be decoded with nut_seek_pts() to its pts.
+ *
+ * EOR frames are never given. As in nut_seek_pts(), one at or before a
+ * target means the stream has nothing to show there, and the first
+ * keyframe after the target is given instead of the one before the EOR
+ * frame.
+ *
+ * Targets close enough to be reached by reading on, as far as the
+ * syncpoint cache can tell, are found without seeking. The others are
+ * found with a backwards nut_seek_pts() with only \a stream active.
+ * Close targets may give the same keyframe.
+ *
+ * Reading continues from wherever the last target was found, call
+ * nut_seek() to resume playback elsewhere. Input streams that give
+ * #NUT_ERR_EAGAIN are not supported.
+ *
+ * Returns #NUT_ERR_EOF if \a stream has no keyframe at all for a target,
+ * and #NUT_ERR_GENERAL_ERROR if \a stream does not exist.
+ */
+
+/*! \fn int nut_write_syncpoint_cache(nut_context_tt * nut, nut_output_stream_tt * out)
+ * \param nut NUT demuxer context
+ * \param out Where to write the cache. If nut_output_stream_tt::write is
+ *            NULL, nut_output_stream_tt::priv is used as FILE*.
+ *
+ * Writes every syncpoint found so far, together with the keyframe and EOR
+ * pts known for them, in a single call to nut_output_stream_tt::write().
+ * Most useful for files without an index, after nut_seek() has searched
+ * them. The cache is tagged with the size of the input file and, if it is
+ * given as FILE*, with its modification time.
+ *
+ * May be called at any time after nut_read_headers(), except while
+ * nut_seek() is being repeated for #NUT_ERR_EAGAIN.
+ */
+
+/*! \fn int nut_read_syncpoint_cache(nut_context_tt * nut, nut_input_stream_tt * in)
+ * \param nut NUT demuxer context
+ * \param in  Where to read the cache from, until nut_input_stream_tt::read
+ *            returns 0. If nut_input_stream_tt::read is NULL,
+ *            nut_input_stream_tt::priv is used as FILE*. Only read is used.
+ *
+ * Must be called after nut_read_headers(). The loaded syncpoints are then
+ * used by nut_seek() just like an index read from the file.
+ *
+ * Returns #NUT_ERR_CACHE_MISMATCH if the size or modification time of the
+ * input file differ from when the cache was written, or if the size is not
+ * known. With a custom nut_input_stream_tt, the size is only known once
+ * the demuxer has seeked to the end of the file, as it does for
+ * nut_demuxer_opts_tt::read_index. Any error leaves the current
+ * syncpoint cache untouched. Does nothing if
+ * nut_demuxer_opts_tt::cache_syncpoints is unset.
+ */
+
+/*! \fn int nut_scan_index(nut_context_tt * nut, off_t start, off_t end, nut_index_tt * index)
+ * \param nut   NUT demuxer context, opened without
+ *              nut_demuxer_opts_tt::read_index.
+ * \param start Position to start at, the first syncpoint at or after it.
+ *              Needs nut_input_stream_tt::seek if it is past the current
+ *              position.
+ * \param end   Position to stop at, the scan ends on the first syncpoint at
+ *              or after it. 0 scans to the end of the file.
+ * \param index Must be zeroed before the first call. Every array in it is
+ *              allocated with nut_demuxer_opts_tt::alloc and belongs to
+ *              the caller.
+ *
+ * Must be called after nut_read_headers(), instead of reading packets.
+ * With \a end set, the last syncpoint in \a index is the one the scan
+ * stopped on, and the first one of a scan from \a end has no keyframes.
+ * Scanning the parts of a file in separate contexts and joining them, with
+ * the syncpoint at every boundary taken from the part before it, gives the
+ * same as scanning the whole file at once.
+ *
+ * Frames are counted in nut_index_tt::frames, nut_index_tt::max_pts and
+ * nut_index_tt::data_end as they are read, so after #NUT_ERR_EAGAIN the
+ * call must be repeated with the same \a index. The syncpoint tables are
+ * only filled in once it returns 0.
+ */
+
 #endif // LIBNUT_NUT_H
@@ -0,0 +1,83 @@
+// (C) 2026 agent
+// This file is available under the MIT/X license, see COPYING
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "libnut.h"
+#include "priv.h"
+
+// Memory accounting for nut_get_memory(). nut_alloc_tt has no opaque
+// pointer to tell contexts apart, so instead of wrapping the allocator,
+// the big structures are measured by their allocated sizes. What contexts
+// share through nut_demuxer_init_shared() is not counted by any of them.
+
+static size_t syncpoint_memory(nut_context_tt * nut) {
+	syncpoint_list_tt * sl = &nut->syncpoints;
+	size_t n = sl->alloc_len * sizeof(syncpoint_tt) + sl->bounds_bytes + sl->linked_bytes;
+	int i;
+	if (sl->shared) return sl->linked_bytes;
+	for (i = 0; sl->keys && i < nut->stream_count; i++) {
+		n += sl->keys[i].alloc_len * sizeof(sparse_pts_tt);
+		n += sl->eor[i].alloc_len * sizeof(sparse_pts_tt);
+	}
+	return n;
+}
+
+static size_t buffer_memory(nut_context_tt * nut) {
+	if (nut->i) { // demuxer
+		size_t n = nut->i->map ? 0 : nut->i->write_len;
+		if (nut->i->prefetch) n += 2 * (size_t)nut->dopts.prefetch;
+		return n;
+	}
+	return nut->o->write_len + nut->tmp_buffer->write_len + nut->tmp_buffer2->write_len;
+}
+
+static size_t reorder_memory(nut_context_tt * nut) {
+	size_t n = 0;
+	int i, j;
+	for (i = 0; nut->sc && i < nut->stream_count; i++) {
+		n += nut->sc[i].num_packets * sizeof(reorder_packet_tt);
+		for (j = 0; j < nut->sc[i].num_packets; j++) n += nut->sc[i].packets[j].p.len;
+	}
+	return n;
+}
+
+static size_t header_memory(nut_context_tt * nut) {
+	size_t n = 0;
+	int i, j;
+	if (!nut->sc) return 0; // the demuxer has not read the headers yet
+	if (!nut->shared) n += nut->timebase_count * sizeof(nut_timebase_tt);
+	n += nut->stream_count * (sizeof(stream_context_tt) + sizeof(nut_stream_stats_tt));
+	for (i = 0; i < nut->stream_count; i++) {
+		nut_stream_header_tt * sh = &nut->sc[i].sh;
+		if (!nut->shared) n += sh->fourcc_len + sh->codec_specific_len;
+		n += sh->decode_delay * sizeof(int64_t) * (nut->i ? 1 : 2); // the muxer has a second cache for reordering
+	}
+	if (nut->shared) return n;
+	for (i = 0; i < nut->info_count; i++) {
+		n += sizeof(nut_info_packet_tt) + nut->info[i].count * sizeof(nut_info_field_tt);
+		for (j = 0; j < nut->info[i].count; j++) if (nut->info[i].fields[j].data) n += nut->info[i].fields[j].val;
+	}
+	return n;
+}
+
+void memory_update(nut_context_tt * nut) {
+	nut_memory_tt * m = &nut->memory;
+	int i;
+	m->current[NUT_MEM_SYNCPOINTS] = syncpoint_memory(nut);
+	m->current[NUT_MEM_BUFFERS] = buffer_memory(nut);
+	m->current[NUT_MEM_REORDER] = reorder_memory(nut);
+	m->current[NUT_MEM_HEADERS] = header_memory(nut);
+	m->total = 0;
+	for (i = 0; i < NUT_MEM_CATEGORIES; i++) {
+		m->total += m->current[i];
+		m->peak[i] = MAX(m->peak[i], m->current[i]);
+	}
+	m->total_peak = MAX(m->total_peak, m->total);
+}
+
+void nut_get_memory(nut_context_tt * nut, nut_memory_tt * mem) {
+	memory_update(nut);
+	*mem = nut->memory;
+}
@@ -37,17 +37,23 @@ static void ready_write_buf(output_buffer_tt * bc, int amount) {
 
 static output_buffer_tt * new_mem_buffer(nut_alloc_tt * alloc) {
 	output_buffer_tt * bc = alloc->malloc(sizeof(output_buffer_tt));
+	if (!bc) return NULL;
 	bc->alloc = alloc;
 	bc->write_len = PREALLOC_SIZE;
 	bc->is_mem = 1;
 	bc->file_pos = 0;
 	bc->buf_ptr = bc->buf = alloc->malloc(bc->write_len);
 	bc->osc.write = NULL;
+	if (!bc->buf) {
+		alloc->free(bc);
+		return NULL;
+	}
 	return bc;
 }
 
 static output_buffer_tt * new_output_buffer(nut_alloc_tt * alloc, nut_output_stream_tt osc) {
 	output_buffer_tt * bc = new_mem_buffer(alloc);
+	if (!bc) return NULL;
 	bc->is_mem = 0;
 	bc->osc = osc;
 	if (!bc->osc.write) bc->osc.write = stream_write;
@@ -126,12 +132,12 @@ static void put_header(output_buffer_tt * bc, output_buffer_tt * in, output_buff
 	// packet_header
 	put_bytes(tmp, 8, startcode);
 	put_v(tmp, forward_ptr);
-	if (forward_ptr > 4096) put_bytes(tmp, 4, crc32(tmp->buf, bctello(tmp)));
+	if (forward_ptr > 4096) put_bytes(tmp, 4, nut_crc32(tmp->buf, bctello(tmp)));
 	put_data(bc, bctello(tmp), tmp->buf);
 
 	// packet_footer
 	if (index_ptr) put_bytes(in, 8, bctello(tmp) + bctello(in) + 8 + 4);
-	put_bytes(in, 4, crc32(in->buf, bctello(in)));
+	put_bytes(in, 4, nut_crc32(in->buf, bctello(in)));
 
 	put_data(bc, bctello(in), in->buf);
 	if (startcode != SYNCPOINT_STARTCODE) debug_msg("header/index size: %d\n", (int)(bctello(tmp) + bctello(in)));
@@ -268,58 +274,68 @@ static void put_headers(nut_context_tt * nut) {
 	put_main_header(nut);
 	for (i = 0; i < nut->stream_count; i++) put_stream_header(nut, i);
 	for (i = 0; i < nut->info_count; i++) put_info(nut, &nut->info[i]);
+	nut->stats.header_bytes += bctello(nut->o) - nut->last_headers;
+}
+
+static int sparse_append(nut_context_tt * nut, sparse_list_tt * l, int sp, uint64_t pts) {
+	if (l->alloc_len <= l->len) {
+		int alloc_len = l->alloc_len ? l->alloc_len * 2 : 16;
+		sparse_pts_tt * e = nut->alloc->realloc(l->e, alloc_len * sizeof(sparse_pts_tt));
+		if (!e) return NUT_ERR_OUT_OF_MEM; // l is unchanged
+		l->e = e;
+		l->alloc_len = alloc_len;
+	}
+	l->e[l->len].sp = sp;
+	l->e[l->len++].pts = pts;
+	return 0;
 }
 
 static void put_syncpoint(nut_context_tt * nut) {
 	output_buffer_tt * tmp = clear_buffer(nut->tmp_buffer);
-	int i;
+	int i, j;
 	uint64_t pts = 0;
 	int timebase = 0;
 	int back_ptr = 0;
-	int keys[nut->stream_count];
 	syncpoint_list_tt * s = &nut->syncpoints;
 
 	nut->last_syncpoint = bctello(nut->o);
 
-	for (i = 0; i < nut->stream_count; i++) {
-		if (nut->sc[i].last_dts > 0 && compare_ts(nut->sc[i].last_dts, TO_TB(i), pts, nut->tb[timebase]) > 0) {
-			pts = nut->sc[i].last_dts;
-			timebase = nut->sc[i].timebase_id;
-		}
+	if ((i = nut->max_dts_stream) != -1 && nut->sc[i].last_dts > 0) {
+		pts = nut->sc[i].last_dts;
+		timebase = nut->sc[i].timebase_id;
 	}
 
 	if (s->alloc_len <= s->len) {
 		s->alloc_len += PREALLOC_SIZE;
 		s->s = nut->alloc->realloc(s->s, s->alloc_len * sizeof(syncpoint_tt));
-		s->pts = nut->alloc->realloc(s->pts, s->alloc_len * nut->stream_count * sizeof(uint64_t));
-		s->eor = nut->alloc->realloc(s->eor, s->alloc_len * nut->stream_count * sizeof(uint64_t));
 	}
 
 	for (i = 0; i < nut->stream_count; i++) {
-		s->pts[s->len * nut->stream_count + i] = nut->sc[i].last_key;
-		s->eor[s->len * nut->stream_count + i] = nut->sc[i].eor > 0 ? nut->sc[i].eor : 0;
+		// without memory for them, no index is written rather than a wrong one
+		if (nut->sc[i].last_key && sparse_append(nut, &s->keys[i], s->len, nut->sc[i].last_key)) nut->mopts.write_index = 0;
+		if (nut->sc[i].eor > 0 && sparse_append(nut, &s->eor[i], s->len, nut->sc[i].eor)) nut->mopts.write_index = 0;
 	}
 	s->s[s->len].pos = nut->last_syncpoint;
 	s->len++;
 
-	for (i = 0; i < nut->stream_count; i++) keys[i] = !!nut->sc[i].eor;
-	for (i = s->len; --i; ) {
-		int j;
-		int n = 1;
-		for (j = 0; j < nut->stream_count; j++) {
-			if (keys[j]) continue;
-			if (!s->pts[i * nut->stream_count + j]) continue;
-			if (compare_ts(s->pts[i * nut->stream_count + j] - 1, TO_TB(j), pts, nut->tb[timebase]) <= 0) keys[j] = 1;
-		}
-		for (j = 0; j < nut->stream_count; j++) n &= keys[j];
-		if (n) { i--; break; }
+	// find the latest syncpoint before a keyframe of every stream, streams with eor don't count
+	i = s->len - 1;
+	for (j = 0; j < nut->stream_count && i; j++) {
+		sparse_list_tt * l = &s->keys[j];
+		int k;
+		if (nut->sc[j].eor) continue;
+		for (k = l->len; k--; ) if (compare_ts(l->e[k].pts - 1, TO_TB(j), pts, nut->tb[timebase]) <= 0) break;
+		i = k >= 0 ? MIN(i, l->e[k].sp) : 0;
 	}
+	if (i) i--;
 	back_ptr = (nut->last_syncpoint - s->s[i].pos) / 16;
 	if (!nut->mopts.write_index) { // clear some syncpoint cache if possible
 		s->len -= i;
 		memmove(s->s, s->s + i, s->len * sizeof(syncpoint_tt));
-		memmove(s->pts, s->pts + i * nut->stream_count, s->len * nut->stream_count * sizeof(uint64_t));
-		memmove(s->eor, s->eor + i * nut->stream_count, s->len * nut->stream_count * sizeof(uint64_t));
+		for (j = 0; j < nut->stream_count; j++) {
+			sparse_shift(&s->keys[j], i, -i);
+			sparse_shift(&s->eor[j], i, -i);
+		}
 	}
 
 	for (i = 0; i < nut->stream_count; i++) {
@@ -332,20 +348,22 @@ static void put_syncpoint(nut_context_tt * nut) {
 	put_v(tmp, back_ptr);
 
 	put_header(nut->o, tmp, nut->tmp_buffer2, SYNCPOINT_STARTCODE, 0);
+	probe(syncpoint_write, nut->last_syncpoint, pts * nut->timebase_count + timebase, back_ptr);
 
-	nut->sync_overhead += bctello(tmp) + bctello(nut->tmp_buffer2);
+	nut->stats.syncpoints++;
+	nut->stats.syncpoint_bytes += bctello(nut->o) - nut->last_syncpoint;
+	memory_update(nut);
 }
 
-static void put_index(nut_context_tt * nut) {
+static void put_index(nut_context_tt * nut, const syncpoint_list_tt * s, const uint64_t * stream_max_pts) {
 	output_buffer_tt * tmp = clear_buffer(nut->tmp_buffer);
-	syncpoint_list_tt * s = &nut->syncpoints;
 	int i;
 	uint64_t max_pts = 0;
 	int timebase = 0;
 
 	for (i = 0; i < nut->stream_count; i++) {
-		if (compare_ts(nut->sc[i].sh.max_pts, TO_TB(i), max_pts, nut->tb[timebase]) > 0) {
-			max_pts = nut->sc[i].sh.max_pts;
+		if (compare_ts(stream_max_pts[i], TO_TB(i), max_pts, nut->tb[timebase]) > 0) {
+			max_pts = stream_max_pts[i];
 			timebase = nut->sc[i].timebase_id;
 		}
 	}
@@ -360,14 +378,15 @@ static void put_index(nut_context_tt * nut) {
 
 	for (i = 0; i < nut->stream_count; i++) {
 		uint64_t a, last = 0; // all of pts[] array is off by one. using 0 for last pts is equivalent to -1 in spec.
+		sparse_list_tt * keys = &s->keys[i], * eor = &s->eor[i];
 		int j;
 		for (j = 0; j < s->len; ) {
 			int k;
 			a = 0;
-			for (k = 0; k < 5 && j+k < s->len; k++) a |= !!s->pts[(j + k) * nut->stream_count + i] << k;
+			for (k = 0; k < 5 && j+k < s->len; k++) a |= !!sparse_get(keys, j + k) << k;
 			if (a == 0 || a == ((1 << k) - 1)) {
 				int flag = a & 2;
-				for (k = 0; j+k < s->len; k++) if (!s->pts[(j+k) * nut->stream_count + i] != !flag) break;
+				for (k = 0; j+k < s->len; k++) if (!sparse_get(keys, j + k) != !flag) break;
 				put_v(tmp, k << 2 | flag | 1);
 				if (j+k < s->len) k++;
 			} else {
@@ -375,7 +394,7 @@ static void put_index(nut_context_tt * nut) {
 					uint64_t b = 0;
 					int tmp2;
 					for (tmp2 = 0; tmp2 < 7 && j+k+tmp2 < s->len; tmp2++) {
-						b |= !!s->pts[(j + k + tmp2) * nut->stream_count + i] << tmp2;
+						b |= !!sparse_get(keys, j + k + tmp2) << tmp2;
 					}
 					if (b == 0 || b == ((1 << tmp2) - 1)) break;
 					a |= b << k;
@@ -385,16 +404,16 @@ static void put_index(nut_context_tt * nut) {
 			}
 			assert(k > 4 || j+k == s->len);
 			j += k;
-			for (k = j - k; k < j; k++) {
-				if (!s->pts[k * nut->stream_count + i]) continue;
-				if (s->eor[k * nut->stream_count + i]) {
+			for (k = sparse_find(keys, j - k); k < keys->len && keys->e[k].sp < j; k++) {
+				uint64_t pts = keys->e[k].pts, e = sparse_get(eor, keys->e[k].sp);
+				if (e) {
 					put_v(tmp, 0);
-					put_v(tmp, s->pts[k * nut->stream_count + i] - last);
-					put_v(tmp, s->eor[k * nut->stream_count + i] - s->pts[k * nut->stream_count + i]);
-					last = s->eor[k * nut->stream_count + i];
+					put_v(tmp, pts - last);
+					put_v(tmp, e - pts);
+					last = e;
 				} else {
-					put_v(tmp, s->pts[k * nut->stream_count + i] - last);
-					last = s->pts[k * nut->stream_count + i];
+					put_v(tmp, pts - last);
+					last = pts;
 				}
 			}
 		}
@@ -405,8 +424,9 @@ static void put_index(nut_context_tt * nut) {
 
 static int frame_header(nut_context_tt * nut, output_buffer_tt * tmp, const nut_packet_tt * fd) {
 	stream_context_tt * sc = &nut->sc[fd->stream];
-	int i, ftnum = -1, size = 0, coded_pts, coded_flags = 0, msb_pts = (1 << sc->msb_pts_shift);
-	int checksum = 0, pts_delta = (int64_t)fd->pts - (int64_t)sc->last_pts;
+	int i, ftnum = -1, size = 0, coded_flags = 0, msb_pts = (1 << sc->msb_pts_shift);
+	int checksum = 0;
+	int64_t coded_pts, pts_delta = (int64_t)fd->pts - (int64_t)sc->last_pts;
 
 	if (ABS(pts_delta) < (msb_pts/2) - 1) coded_pts = fd->pts & (msb_pts - 1);
 	else coded_pts = fd->pts + msb_pts;
@@ -450,7 +470,9 @@ static int frame_header(nut_context_tt * nut, output_buffer_tt * tmp, const nut_
 		if (coded_flags & FLAG_STREAM_ID) put_v(tmp, fd->stream);
 		if (coded_flags & FLAG_CODED_PTS) put_v(tmp, coded_pts);
 		if (coded_flags & FLAG_SIZE_MSB)  put_v(tmp, (fd->len - nut->ft[ftnum].lsb) / nut->ft[ftnum].mul);
-		if (coded_flags & FLAG_CHECKSUM)  put_bytes(tmp, 4, crc32(tmp->buf, bctello(tmp)));
+		if (coded_flags & FLAG_CHECKSUM)  put_bytes(tmp, 4, nut_crc32(tmp->buf, bctello(tmp)));
+		if (coded_flags & FLAG_CHECKSUM)  nut->stream_stats[fd->stream].checksum_frames++;
+		if (coded_flags & FLAG_CODED)     nut->stream_stats[fd->stream].coded_frames++;
 	}
 	return size;
 }
@@ -479,8 +501,9 @@ static void check_header_repetition(nut_context_tt * nut) {
 
 void nut_write_frame(nut_context_tt * nut, const nut_packet_tt * fd, const uint8_t * buf) {
 	stream_context_tt * sc = &nut->sc[fd->stream];
+	nut_stream_stats_tt * st = &nut->stream_stats[fd->stream];
 	output_buffer_tt * tmp;
-	int i;
+	int i, len;
 
 	check_header_repetition(nut);
 	// distance syncpoints
@@ -488,15 +511,16 @@ void nut_write_frame(nut_context_tt * nut, const nut_packet_tt * fd, const uint8
 		bctello(nut->o) - nut->last_syncpoint + fd->len + frame_header(nut, NULL, fd) > nut->max_distance) put_syncpoint(nut);
 
 	tmp = clear_buffer(nut->tmp_buffer);
-	sc->overhead += frame_header(nut, tmp, fd);
-	sc->total_frames++;
-	sc->tot_size += fd->len;
+	len = frame_header(nut, tmp, fd);
+	probe(frame_write, bctello(nut->o), fd->stream, fd->pts, fd->len, fd->flags, len);
+	st->header_bytes += len;
+	st->frames++;
+	st->bytes += fd->len;
 
 	put_data(nut->o, bctello(tmp), tmp->buf);
 	put_data(nut->o, fd->len, buf);
 
-        for (i = 0; i < nut->stream_count; i++) {
-		if (nut->sc[i].last_dts == -1) continue;
+	if ((i = nut->max_dts_stream) != -1) {
 		if (compare_ts(fd->pts, TO_TB(fd->stream), nut->sc[i].last_dts, TO_TB(i)) < 0)
 			debug_msg("%lld %d (%f) %lld %d (%f) \n",
 				fd->pts, fd->stream, TO_DOUBLE(fd->stream, fd->pts),
@@ -506,6 +530,7 @@ void nut_write_frame(nut_context_tt * nut, const nut_packet_tt * fd, const uint8
 
 	sc->last_pts = fd->pts;
 	sc->last_dts = get_dts(sc->sh.decode_delay, sc->pts_cache, fd->pts);
+	update_max_dts(nut, fd->stream);
 	sc->sh.max_pts = MAX(sc->sh.max_pts, fd->pts);
 
 	if ((fd->flags & NUT_FLAG_KEY) && !sc->last_key) sc->last_key = fd->pts + 1;
@@ -520,6 +545,7 @@ void nut_write_info(nut_context_tt * nut, const nut_info_packet_tt * info) {
 
 	nut->last_headers = bctello(nut->o); // to force syncpoint writing after the info header
 	put_info(nut, info);
+	nut->stats.header_bytes += bctello(nut->o) - nut->last_headers;
 	if (nut->mopts.realtime_stream) flush_buf(nut->o);
 }
 
@@ -578,21 +604,34 @@ nut_context_tt * nut_muxer_init(const nut_muxer_opts_tt * mopts, const nut_strea
 	debug_msg("   { %4d, %3d, %6d, %3d, %4d, %5d },\n", fti[n].flag, fti[n].pts, fti[n].stream, fti[n].mul, fti[n].size, fti[n].count);
 	assert(fti[n].flag == -1);
 
-	nut->sync_overhead = 0;
+	memset(&nut->stats, 0, sizeof(nut_stats_tt));
+	memset(&nut->memory, 0, sizeof(nut_memory_tt));
+	nut->i = NULL;
 
 	nut->syncpoints.len = 0;
 	nut->syncpoints.alloc_len = 0;
 	nut->syncpoints.s = NULL;
-	nut->syncpoints.pts = NULL;
+	nut->syncpoints.keys = NULL;
 	nut->syncpoints.eor = NULL;
+	nut->syncpoints.bounds_bytes = 0;
+	nut->syncpoints.linked_bytes = 0;
+	nut->syncpoints.inside = 0;
+	nut->syncpoints.shared = 0;
+	nut->shared = NULL;
 	nut->last_syncpoint = 0;
 	nut->headers_written = 0;
 
 	for (nut->stream_count = 0; s[nut->stream_count].type >= 0; nut->stream_count++);
 
 	nut->sc = nut->alloc->malloc(sizeof(stream_context_tt) * nut->stream_count);
+	nut->stream_stats = nut->alloc->malloc(sizeof(nut_stream_stats_tt) * nut->stream_count);
+	memset(nut->stream_stats, 0, sizeof(nut_stream_stats_tt) * nut->stream_count);
+	nut->stats.streams = nut->stream_stats;
+	nut->syncpoints.keys = nut->alloc->malloc(sizeof(sparse_list_tt) * nut->stream_count);
+	nut->syncpoints.eor = nut->alloc->malloc(sizeof(sparse_list_tt) * nut->stream_count);
 	nut->tb = NULL;
 	nut->timebase_count = 0;
+	nut->max_dts_stream = -1;
 
 	for (i = 0; i < nut->stream_count; i++) {
 		int j;
@@ -602,6 +641,7 @@ nut_context_tt * nut_muxer_init(const nut_muxer_opts_tt * mopts, const nut_strea
 		nut->sc[i].msb_pts_shift = 7; // TODO
 		nut->sc[i].max_pts_distance = (s[i].time_base.den + s[i].time_base.num - 1) / s[i].time_base.num; // TODO
 		nut->sc[i].eor = 0;
+		nut->syncpoints.keys[i] = nut->syncpoints.eor[i] = (sparse_list_tt){0, 0, NULL};
 		nut->sc[i].sh = s[i];
 		nut->sc[i].sh.max_pts = 0;
 
@@ -621,11 +661,6 @@ nut_context_tt * nut_muxer_init(const nut_muxer_opts_tt * mopts, const nut_strea
 		nut->sc[i].next_pts = 0;
 		nut->sc[i].packets = NULL;
 		nut->sc[i].num_packets = 0;
-
-		// debug
-		nut->sc[i].total_frames = 0;
-		nut->sc[i].overhead = 0;
-		nut->sc[i].tot_size = 0;
 	}
 
 	if (info) {
@@ -664,38 +699,99 @@ nut_context_tt * nut_muxer_init(const nut_muxer_opts_tt * mopts, const nut_strea
 
 	if (nut->mopts.realtime_stream) flush_buf(nut->o);
 
+	memory_update(nut);
 	return nut;
 }
 
+#define CHECK(expr) do { if ((err = (expr))) goto err_out; } while(0)
+#define ERROR(expr, code) do { if (expr) { err = code; goto err_out; } } while(0)
+
+int nut_write_index(nut_context_tt * nut, const nut_index_tt * index, nut_output_stream_tt * out) {
+	// the buffers of a demuxer context are not output buffers, so the writing gets its own
+	output_buffer_tt * o = nut->o, * tmp_buffer = nut->tmp_buffer, * tmp_buffer2 = nut->tmp_buffer2;
+	syncpoint_list_tt s = { 0 };
+	int i, j, err = 0;
+
+	nut->o = new_output_buffer(nut->alloc, *out);
+	nut->tmp_buffer = new_mem_buffer(nut->alloc);
+	nut->tmp_buffer2 = new_mem_buffer(nut->alloc);
+	s.s = nut->alloc->malloc((index->len + 1) * sizeof(syncpoint_tt));
+	s.keys = nut->alloc->malloc(nut->stream_count * sizeof(sparse_list_tt));
+	s.eor = nut->alloc->malloc(nut->stream_count * sizeof(sparse_list_tt));
+	if (s.keys && s.eor) for (j = 0; j < nut->stream_count; j++) s.keys[j] = s.eor[j] = (sparse_list_tt){0, 0, NULL};
+	ERROR(!nut->o || !nut->tmp_buffer || !nut->tmp_buffer2 || !s.s || !s.keys || !s.eor, NUT_ERR_OUT_OF_MEM);
+
+	s.len = index->len;
+	for (i = 0; i < index->len; i++) {
+		s.s[i].pos = index->pos[i];
+		for (j = 0; j < nut->stream_count; j++) {
+			if (index->keys[i * nut->stream_count + j]) CHECK(sparse_append(nut, &s.keys[j], i, index->keys[i * nut->stream_count + j]));
+			if (index->eor[i * nut->stream_count + j]) CHECK(sparse_append(nut, &s.eor[j], i, index->eor[i * nut->stream_count + j]));
+		}
+	}
+
+	// all of the index is built before anything is written to out
+	put_main_header(nut);
+	for (i = 0; i < nut->stream_count; i++) put_stream_header(nut, i);
+	for (i = 0; i < nut->info_count; i++) put_info(nut, &nut->info[i]);
+	put_index(nut, &s, index->max_pts);
+
+err_out:
+	if (s.keys && s.eor) for (j = 0; j < nut->stream_count; j++) {
+		nut->alloc->free(s.keys[j].e);
+		nut->alloc->free(s.eor[j].e);
+	}
+	nut->alloc->free(s.s);
+	nut->alloc->free(s.keys);
+	nut->alloc->free(s.eor);
+	free_buffer(nut->tmp_buffer);
+	free_buffer(nut->tmp_buffer2);
+	free_buffer(nut->o); // flushes to out
+	nut->o = o;
+	nut->tmp_buffer = tmp_buffer;
+	nut->tmp_buffer2 = tmp_buffer2;
+	return err;
+}
+
 void nut_muxer_uninit(nut_context_tt * nut) {
 	int i;
-	int total = 0;
+	uint64_t total = 0;
 	if (!nut) return;
 
 	if (!nut->mopts.realtime_stream) {
 		while (nut->headers_written < 2) put_headers(nut); // force 3rd copy of main headers
 		put_headers(nut);
 	}
-	if (nut->mopts.write_index) put_index(nut);
+	if (nut->mopts.write_index) {
+		off_t start = bctello(nut->o);
+		uint64_t max_pts[nut->stream_count];
+		for (i = 0; i < nut->stream_count; i++) max_pts[i] = nut->sc[i].sh.max_pts;
+		put_index(nut, &nut->syncpoints, max_pts);
+		nut->stats.index_bytes = bctello(nut->o) - start;
+	}
 
 	for (i = 0; i < nut->stream_count; i++) {
-		total += nut->sc[i].tot_size;
+		nut_stream_stats_tt * st = &nut->stream_stats[i];
+		total += st->bytes;
 		debug_msg("Stream %d:\n", i);
-		debug_msg("   frames: %d\n", nut->sc[i].total_frames);
+		debug_msg("   frames: %d\n", (int)st->frames);
 		debug_msg("   TOT: ");
-		debug_msg("packet size: %d ", nut->sc[i].tot_size);
-		debug_msg("packet overhead: %d ", nut->sc[i].overhead);
-		debug_msg("(%.2lf%%)\n", (double)nut->sc[i].overhead / nut->sc[i].tot_size * 100);
+		debug_msg("packet size: %d ", (int)st->bytes);
+		debug_msg("packet overhead: %d ", (int)st->header_bytes);
+		debug_msg("(%.2lf%%)\n", (double)st->header_bytes / st->bytes * 100);
 		debug_msg("   AVG: ");
-		debug_msg("packet size: %.2lf ", (double)nut->sc[i].tot_size / nut->sc[i].total_frames);
-		debug_msg("packet overhead: %.2lf\n", (double)nut->sc[i].overhead / nut->sc[i].total_frames);
+		debug_msg("packet size: %.2lf ", (double)st->bytes / st->frames);
+		debug_msg("packet overhead: %.2lf\n", (double)st->header_bytes / st->frames);
 
 		nut->alloc->free(nut->sc[i].sh.fourcc);
 		nut->alloc->free(nut->sc[i].sh.codec_specific);
 		nut->alloc->free(nut->sc[i].pts_cache);
 		nut->alloc->free(nut->sc[i].reorder_pts_cache);
+		nut->alloc->free(nut->syncpoints.keys[i].e);
+		nut->alloc->free(nut->syncpoints.eor[i].e);
 	}
 	nut->alloc->free(nut->sc);
+	nut->alloc->free(nut->stream_stats);
 	nut->alloc->free(nut->tb);
 
 	for (i = 0; i < nut->info_count; i++) {
@@ -705,15 +801,15 @@ void nut_muxer_uninit(nut_context_tt * nut) {
 	}
 	nut->alloc->free(nut->info);
 
-	debug_msg("Syncpoints: %d size: %d\n", nut->syncpoints.len, nut->sync_overhead);
+	debug_msg("Syncpoints: %d size: %d\n", (int)nut->stats.syncpoints, (int)nut->stats.syncpoint_bytes);
 
 	nut->alloc->free(nut->syncpoints.s);
-	nut->alloc->free(nut->syncpoints.pts);
+	nut->alloc->free(nut->syncpoints.keys);
 	nut->alloc->free(nut->syncpoints.eor);
 
 	free_buffer(nut->tmp_buffer);
 	free_buffer(nut->tmp_buffer2);
-	debug_msg("TOTAL: %d bytes data, %d bytes overhead, %.2lf%% overhead\n", total,
+	debug_msg("TOTAL: %d bytes data, %d bytes overhead, %.2lf%% overhead\n", (int)total,
 		(int)bctello(nut->o) - total, (double)(bctello(nut->o) - total) / total*100);
 	free_buffer(nut->o); // flushes file
 	nut->alloc->free(nut);
@@ -0,0 +1,201 @@
+// (C) 2026 agent
+// This file is available under the MIT/X license, see COPYING
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "libnut.h"
+#include "priv.h"
+
+// Double buffered read-ahead of a nut_input_stream_tt. A worker thread
+// fills one block while the demuxer copies out of the other one. The
+// user's callbacks are only ever called by one thread at a time.
+
+typedef struct {
+	uint8_t * data;
+	off_t pos;  // file position of data[0]
+	size_t len; // bytes filled by the worker
+	size_t off; // bytes already given to the demuxer
+	int ready;
+} prefetch_block_tt;
+
+struct prefetch_s {
+	nut_input_stream_tt isc; // the user's stream
+	nut_alloc_tt * alloc;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	prefetch_block_tt block[2];
+	int head;         // block the demuxer reads from, the worker fills the other one first
+	size_t block_size;
+	off_t pos;        // position as seen by the demuxer
+	off_t next_pos;   // position of the user's stream, where the next block starts
+	int busy;         // worker is inside isc.read(), must not be touched
+	int stall;        // last read returned nothing, wait until the demuxer asks again
+	int pause;        // a seek is in progress
+	int quit;
+};
+
+static void * prefetch_worker(void * priv) {
+	prefetch_tt * pf = priv;
+	pthread_mutex_lock(&pf->lock);
+	for (;;) {
+		prefetch_block_tt * b;
+		size_t len;
+		while (!pf->quit && (pf->pause || pf->stall || (pf->block[0].ready && pf->block[1].ready))) pthread_cond_wait(&pf->cond, &pf->lock);
+		if (pf->quit) break;
+		b = &pf->block[pf->block[pf->head].ready ? !pf->head : pf->head];
+		b->pos = pf->next_pos;
+		pf->busy = 1;
+		pthread_mutex_unlock(&pf->lock);
+
+		len = pf->isc.read(pf->isc.priv, pf->block_size, b->data);
+
+		pthread_mutex_lock(&pf->lock);
+		pf->busy = 0;
+		pf->next_pos += len;
+		b->len = len;
+		b->off = 0;
+		b->ready = len > 0;
+		if (!len) pf->stall = 1;
+		pthread_cond_broadcast(&pf->cond);
+	}
+	pthread_mutex_unlock(&pf->lock);
+	return NULL;
+}
+
+static size_t prefetch_read(void * priv, size_t len, uint8_t * buf) {
+	prefetch_tt * pf = priv;
+	size_t done = 0;
+	pthread_mutex_lock(&pf->lock);
+	while (done < len) {
+		prefetch_block_tt * b = &pf->block[pf->head];
+		if (b->ready) {
+			size_t n = MIN(len - done, b->len - b->off);
+			memcpy(buf + done, b->data + b->off, n);
+			b->off += n;
+			done += n;
+			if (b->off == b->len) {
+				b->ready = 0;
+				pf->head = !pf->head;
+				pthread_cond_broadcast(&pf->cond);
+			}
+		} else if (pf->stall && !pf->busy) {
+			// EOF or EAGAIN, report a short read now and let the worker retry
+			pf->stall = 0;
+			pthread_cond_broadcast(&pf->cond);
+			break;
+		} else {
+			pthread_cond_wait(&pf->cond, &pf->lock);
+		}
+	}
+	pf->pos += done;
+	pthread_mutex_unlock(&pf->lock);
+	return done;
+}
+
+static void invalidate_blocks(prefetch_tt * pf) {
+	pf->block[0].ready = pf->block[1].ready = 0;
+	pf->head = 0;
+	pf->stall = 0;
+}
+
+static off_t prefetch_seek(void * priv, long long pos, int whence) {
+	prefetch_tt * pf = priv;
+	int i;
+	pthread_mutex_lock(&pf->lock);
+	if (whence == SEEK_CUR) {
+		pos += pf->pos;
+		whence = SEEK_SET;
+	}
+	if (whence == SEEK_SET) for (i = 0; i < 2; i++) {
+		prefetch_block_tt * b = &pf->block[pf->head ^ i];
+		if (!b->ready || pos < b->pos || pos >= b->pos + (off_t)b->len) continue;
+		// still buffered, no need to disturb the worker
+		if (i) {
+			pf->block[pf->head].ready = 0;
+			pf->head = !pf->head;
+			pthread_cond_broadcast(&pf->cond);
+		}
+		b->off = pos - b->pos;
+		pf->pos = pos;
+		pthread_mutex_unlock(&pf->lock);
+		return pos;
+	}
+
+	pf->pause = 1;
+	while (pf->busy) pthread_cond_wait(&pf->cond, &pf->lock);
+	invalidate_blocks(pf);
+	pf->pos = pf->next_pos = pf->isc.seek(pf->isc.priv, pos, whence);
+	pf->pause = 0;
+	pthread_cond_broadcast(&pf->cond);
+	pthread_mutex_unlock(&pf->lock);
+	return pf->pos;
+}
+
+static int prefetch_eof(void * priv) {
+	prefetch_tt * pf = priv;
+	int ret = 0;
+	pthread_mutex_lock(&pf->lock);
+	while (pf->busy) pthread_cond_wait(&pf->cond, &pf->lock);
+	if (!pf->block[0].ready && !pf->block[1].ready) ret = pf->isc.eof(pf->isc.priv);
+	pthread_mutex_unlock(&pf->lock);
+	return ret;
+}
+
+static void prefetch_hint(void * priv, off_t pos, size_t len) {
+	prefetch_tt * pf = priv;
+	pthread_mutex_lock(&pf->lock);
+	while (pf->busy) pthread_cond_wait(&pf->cond, &pf->lock);
+	pf->isc.hint(pf->isc.priv, pos, len);
+	pthread_mutex_unlock(&pf->lock);
+}
+
+prefetch_tt * prefetch_init(nut_alloc_tt * alloc, nut_input_stream_tt * isc, int block_size) {
+	prefetch_tt * pf = alloc->malloc(sizeof(prefetch_tt));
+	if (!pf) return NULL;
+	pf->isc = *isc;
+	pf->alloc = alloc;
+	pf->block_size = block_size;
+	pf->block[0].data = alloc->malloc(block_size);
+	pf->block[1].data = alloc->malloc(block_size);
+	pf->pos = pf->next_pos = isc->file_pos;
+	pf->busy = pf->pause = pf->quit = 0;
+	invalidate_blocks(pf);
+	if (!pf->block[0].data || !pf->block[1].data) goto err_out;
+	if (pthread_mutex_init(&pf->lock, NULL)) goto err_out;
+	if (pthread_cond_init(&pf->cond, NULL)) goto err_mutex;
+	if (pthread_create(&pf->thread, NULL, prefetch_worker, pf)) goto err_cond;
+
+	isc->priv = pf;
+	isc->read = prefetch_read;
+	if (isc->seek) isc->seek = prefetch_seek;
+	if (isc->eof) isc->eof = prefetch_eof;
+	if (isc->hint) isc->hint = prefetch_hint;
+	return pf;
+
+err_cond:
+	pthread_cond_destroy(&pf->cond);
+err_mutex:
+	pthread_mutex_destroy(&pf->lock);
+err_out:
+	alloc->free(pf->block[0].data);
+	alloc->free(pf->block[1].data);
+	alloc->free(pf);
+	return NULL;
+}
+
+void prefetch_uninit(prefetch_tt * pf) {
+	if (!pf) return;
+	pthread_mutex_lock(&pf->lock);
+	pf->quit = 1;
+	pthread_cond_broadcast(&pf->cond);
+	pthread_mutex_unlock(&pf->lock);
+	pthread_join(pf->thread, NULL);
+	pthread_cond_destroy(&pf->cond);
+	pthread_mutex_destroy(&pf->lock);
+	pf->alloc->free(pf->block[0].data);
+	pf->alloc->free(pf->block[1].data);
+	pf->alloc->free(pf);
+}
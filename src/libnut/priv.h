@@ -7,6 +7,7 @@
 //#define NDEBUG // disables asserts
 //#define DEBUG
 //#define TRACE
+//#define USDT // static probes for perf and bpftrace, needs <sys/sdt.h> from systemtap
 
 #ifdef DEBUG
 #define debug_msg(...) fprintf(stderr, __VA_ARGS__)
@@ -14,6 +15,13 @@
 #define debug_msg(...)
 #endif
 
+#ifdef USDT
+#include <sys/sdt.h>
+#define probe(...) STAP_PROBEV(libnut, __VA_ARGS__) // name, then up to 10 integer or pointer arguments
+#else
+#define probe(...) // arguments are not evaluated
+#endif
+
 #include <assert.h>
 #include <inttypes.h>
 #include <stdlib.h>
@@ -28,6 +36,10 @@
 #define     INDEX_STARTCODE (0xDD672F23E64EULL + (((uint64_t)('N'<<8) + 'X')<<48))
 #define      INFO_STARTCODE (0xAB68B596BA78ULL + (((uint64_t)('N'<<8) + 'I')<<48))
 
+// not part of NUT, starts sidecar files written by nut_write_syncpoint_cache()
+#define     CACHE_STARTCODE (0x9C3A5D20E17BULL + (((uint64_t)('N'<<8) + 'C')<<48))
+#define CACHE_VERSION 1
+
 #define NUT_API_FLAGS    3
 
 #define FLAG_CODED_PTS   8
@@ -44,16 +56,49 @@
 #define MAX(a,b) ((a) > (b) ? (a) : (b))
 #define ABS(a) ((a) > 0 ? (a) : -(a))
 
+// crc32.c
+uint32_t nut_crc32(const uint8_t * buf, int len);
+uint32_t nut_crc32_nibble(const uint8_t * buf, int len); // implementations for benchmarking
+uint32_t nut_crc32_slice8(const uint8_t * buf, int len);
+uint32_t nut_crc32_clmul(const uint8_t * buf, int len);   // slice-by-8 if not supported
+
+// prefetch.c
+typedef struct prefetch_s prefetch_tt;
+prefetch_tt * prefetch_init(nut_alloc_tt * alloc, nut_input_stream_tt * isc, int block_size);
+void prefetch_uninit(prefetch_tt * pf);
+
+// verify.c
+typedef struct verify_s verify_tt;
+verify_tt * verify_init(nut_alloc_tt * alloc);
+void verify_uninit(verify_tt * v);
+int verify_queue(verify_tt * v, const uint8_t * buf, int len, off_t pos, int copy);
+void verify_sync(verify_tt * v);
+int verify_failed(verify_tt * v, off_t * pos);
+
+// memory.c
+void memory_update(nut_context_tt * nut); // counts nut_context_tt::memory again
+
 typedef struct {
 	nut_input_stream_tt isc;
 	int is_mem;
+	uint8_t * base; // allocated memory, buf slides forward inside it
 	uint8_t * buf;
 	uint8_t * buf_ptr;
 	int write_len; // allocated memory
-	int read_len;  // data in memory
+	int read_len;  // data in memory, starting at buf
 	off_t file_pos;
 	off_t filesize;
 	nut_alloc_tt * alloc;
+	uint8_t * map; // non-NULL if input file is memory mapped, buf then points into it
+	off_t map_len;
+	int read_ahead; // current read-ahead window, between read_ahead_min and read_ahead_max
+	int read_ahead_min;
+	int read_ahead_max;
+	int read_ahead_align;
+	prefetch_tt * prefetch; // if non-NULL, isc reads through it
+	int checksums; // enum nut_checksum_tt
+	verify_tt * verify; // for NUT_CHECKSUM_DEFERRED
+	nut_seek_trace_tt * trace; // non-NULL while a traced seek is running
 } input_buffer_tt;
 
 typedef struct {
@@ -73,14 +118,18 @@ typedef struct {
 	int16_t pts_delta;
 	uint8_t reserved;
 	uint8_t stream;
+	uint8_t simple; // demuxer only, no fields besides the frame code, see get_main_header()
 } frame_table_tt;
 
 typedef struct {
 	off_t pos;
 	uint64_t pts; // coded in '% timebase_count'
-	int back_ptr:30;
+	int back_ptr:28;
 	unsigned int seen_next:1;
 	unsigned int pts_valid:1;
+	unsigned int merged:1; // thin_syncpoints() dropped syncpoints right before this one, its region spans them
+	unsigned int inside:1; // found by a seek inside a merged region, removed when the seek is done
+	unsigned int pts_unknown:1; // index entry whose syncpoint hasn't been read yet, pts is 0
 } syncpoint_tt;
 
 typedef struct syncpoint_linked_s syncpoint_linked_tt;
@@ -90,16 +139,40 @@ struct syncpoint_linked_s {
 	uint64_t pts_eor[1];
 };
 
+typedef struct {
+	int sp;       // index in syncpoint_list_tt.s
+	uint64_t pts; // +1 to real pts, like last_key
+} sparse_pts_tt;
+
+typedef struct {
+	int len;
+	int alloc_len;
+	sparse_pts_tt * e; // sorted by sp, syncpoints without a value have no entry
+} sparse_list_tt;
+
+typedef struct {
+	uint64_t * key_hi; // highest pts in keys[] up to each entry, skipping syncpoint 0
+	uint64_t * key_lo; // lowest pts in keys[] from each entry on
+	uint64_t * eor_lo; // lowest pts in eor[] from each entry on
+} seek_bounds_tt;
+
 typedef struct {
 	int len;
 	int alloc_len;
 	syncpoint_tt * s;
-	uint64_t * pts; // each elem is stream_count items, +1 to real pts, 0 means there is no key
-	uint64_t * eor; // same as pts, is the pts of last eor in syncpoint region _IF_ eor is set by syncpoint.
-	int cached_pos;
+	sparse_list_tt * keys; // one per stream, pts of the last keyframe before each syncpoint
+	sparse_list_tt * eor;  // one per stream, pts of the last eor in syncpoint region _IF_ eor is set by syncpoint.
 	syncpoint_linked_tt * linked; // entries are entered in reverse order for speed, points to END of list
+	seek_bounds_tt * bounds; // one per stream, lets nut_seek() bisect keys and eor
+	int bounds_valid;        // cleared whenever keys or eor change
+	size_t bounds_bytes;     // allocated by bounds
+	size_t linked_bytes;     // allocated by linked
+	int inside;              // syncpoints with inside set
+	int shared;              // s, keys, eor and bounds belong to nut_context_tt::shared, copied before any change
 } syncpoint_list_tt;
 
+typedef struct shared_headers_s shared_headers_tt; // demuxer.c
+
 typedef struct {
 	nut_packet_tt p;
 	uint8_t * buf;
@@ -130,10 +203,6 @@ typedef struct {
 	reorder_packet_tt * packets;
 	int num_packets;
 	int64_t * reorder_pts_cache;
-	// debug stuff
-	int overhead;
-	int tot_size;
-	int total_frames;
 } stream_context_tt;
 
 struct nut_context_s {
@@ -161,49 +230,52 @@ struct nut_context_s {
 	off_t last_headers; // for header repetition and state for demuxer
 	int headers_written; // for muxer header repetition
 
+	int max_dts_stream; // stream with the highest last_dts, lowest one on ties, -1 if none
+
 	off_t before_seek; // position before any seek mess
 	off_t seek_status;
 	off_t binary_guess;
+	off_t seek_expand; // merged syncpoint whose region a seek is reading again, 0 if none
 	double seek_time_pos;
+	uint64_t * seek_pts; // seek target in each timebase, rounded down
 
 	syncpoint_list_tt syncpoints;
+	shared_headers_tt * shared; // headers given to nut_demuxer_init_shared(), tb, sh and info belong to it. NULL if none
 	struct find_syncpoint_state_s {
 		int i, begin, seeked;
 		off_t pos;
 	} find_syncpoint_state;
 
-	// debug
-	int sync_overhead;
+	nut_stats_tt stats;
+	nut_memory_tt memory;
+	nut_stream_stats_tt * stream_stats; // stats.streams, one per stream
+	int frame_header_len, frame_header_flags; // of the frame get_packet() parsed last
 };
 
-static inline uint32_t crc32(uint8_t * buf, int len){
-	static const uint32_t table[16] = {
-		0x00000000, 0x04C11DB7, 0x09823B6E, 0x0D4326D9,
-		0x130476DC, 0x17C56B6B, 0x1A864DB2, 0x1E475005,
-		0x2608EDB8, 0x22C9F00F, 0x2F8AD6D6, 0x2B4BCB61,
-		0x350C9B64, 0x31CD86D3, 0x3C8EA00A, 0x384FBDBD,
-	};
-	uint32_t crc = 0;
-	while (len--) {
-		crc ^= *buf++ << 24;
-		crc = (crc<<4) ^ table[crc>>28];
-		crc = (crc<<4) ^ table[crc>>28];
-	}
-	return crc;
-}
-
 static inline uint64_t convert_ts(uint64_t sn, nut_timebase_tt from, nut_timebase_tt to) {
+#ifdef __SIZEOF_INT128__
+	// exact, sn * from.num * to.den may not fit in 64 bits
+	return (unsigned __int128)sn * ((uint64_t)from.num * to.den) / ((uint64_t)from.den * to.num);
+#else
 	uint64_t ln, d1, d2;
 	ln = (uint64_t)from.num * to.den;
 	d1 = from.den;
 	d2 = to.num;
 	return (ln / d1 * sn + (ln%d1) * sn / d1) / d2;
+#endif
 }
 
 static inline int compare_ts(uint64_t a, nut_timebase_tt at, uint64_t b, nut_timebase_tt bt) {
+#ifdef __SIZEOF_INT128__
+	// exact, a * at.num * bt.den needs at most 126 bits
+	unsigned __int128 x = (unsigned __int128)a * ((uint64_t)at.num * bt.den);
+	unsigned __int128 y = (unsigned __int128)b * ((uint64_t)bt.num * at.den);
+	return x < y ? -1 : x > y;
+#else
 	if (convert_ts(a, at, bt) < b) return -1;
 	if (convert_ts(b, bt, at) < a) return  1;
 	return 0;
+#endif
 }
 
 static inline int64_t get_dts(int d, int64_t * pts_cache, int64_t pts) {
@@ -243,4 +315,39 @@ static inline int gcd(int a, int b) {
 
 #define TO_TB(i) nut->tb[nut->sc[i].timebase_id]
 
+static inline int sparse_find(const sparse_list_tt * l, int sp) {
+	// index of the first entry at or after syncpoint sp
+	int lo = 0, hi = l->len;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (l->e[mid].sp < sp) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo;
+}
+
+static inline uint64_t sparse_get(const sparse_list_tt * l, int sp) {
+	int i = sparse_find(l, sp);
+	return i < l->len && l->e[i].sp == sp ? l->e[i].pts : 0;
+}
+
+static inline void sparse_shift(sparse_list_tt * l, int from, int delta) {
+	// syncpoints from 'from' onwards move by delta, entries they are moved over are dropped
+	int i = sparse_find(l, delta < 0 ? from + delta : from);
+	int j = sparse_find(l, from);
+	memmove(l->e + i, l->e + j, (l->len - j) * sizeof(sparse_pts_tt));
+	l->len -= j - i;
+	for (; i < l->len; i++) l->e[i].sp += delta;
+}
+
+static inline void update_max_dts(nut_context_tt * nut, int i) {
+	int m = nut->max_dts_stream;
+	if (nut->sc[i].last_dts == -1 || m == i) return;
+	if (m == -1) nut->max_dts_stream = i;
+	else switch (compare_ts(nut->sc[i].last_dts, TO_TB(i), nut->sc[m].last_dts, TO_TB(m))) {
+		case  1: nut->max_dts_stream = i; break;
+		case  0: if (i < m) nut->max_dts_stream = i; break;
+	}
+}
+
 #endif // LIBNUT_PRIV_H
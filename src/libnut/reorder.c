@@ -88,5 +88,12 @@ void nut_write_frame_reorder(nut_context_tt * nut, const nut_packet_tt * p, cons
 	s->packets[s->num_packets - 1].buf = nut->alloc->malloc(p->len); // FIXME
 	memcpy(s->packets[s->num_packets - 1].buf, buf, p->len);
 
+	{
+		int i, n = 0;
+		for (i = 0; i < nut->stream_count; i++) n += nut->sc[i].num_packets;
+		if (n > nut->stats.reorder_high_water) nut->stats.reorder_high_water = n;
+	}
+	memory_update(nut);
+
 	flushcheck_frames(nut);
 }
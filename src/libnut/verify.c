@@ -0,0 +1,147 @@
+// (C) 2026 agent
+// This file is available under the MIT/X license, see COPYING
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "libnut.h"
+#include "priv.h"
+
+// Checksums verified by a worker thread, for NUT_CHECKSUM_DEFERRED.
+// The demuxer queues the checksummed bytes and later collects the file
+// positions of the ones that failed.
+
+#define MAX_PENDING (1024*1024) // bytes queued before the demuxer waits for the worker
+
+typedef struct verify_job_s {
+	struct verify_job_s * next;
+	const uint8_t * data; // points right after the struct if the data was copied
+	int len;
+	off_t pos;
+} verify_job_tt;
+
+struct verify_s {
+	nut_alloc_tt * alloc;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	verify_job_tt * head, * tail;
+	int pending;     // bytes queued
+	off_t last_pos;  // the same header may be given again after EAGAIN
+	off_t * failed;  // not yet collected by verify_failed()
+	int failed_len, failed_alloc;
+	int busy, quit;
+};
+
+static void * verify_worker(void * priv) {
+	verify_tt * v = priv;
+	pthread_mutex_lock(&v->lock);
+	for (;;) {
+		verify_job_tt * job;
+		int bad;
+		while (!v->quit && !v->head) pthread_cond_wait(&v->cond, &v->lock);
+		if (!v->head) break; // quit, and everything was checked
+		job = v->head;
+		if (!(v->head = job->next)) v->tail = NULL;
+		v->busy = 1;
+		pthread_mutex_unlock(&v->lock);
+
+		bad = nut_crc32(job->data, job->len) != 0;
+
+		pthread_mutex_lock(&v->lock);
+		v->busy = 0;
+		v->pending -= job->len;
+		if (bad) {
+			if (v->failed_len == v->failed_alloc) {
+				off_t * tmp = v->alloc->realloc(v->failed, (v->failed_alloc + 16) * sizeof(off_t));
+				if (tmp) { v->failed = tmp; v->failed_alloc += 16; }
+			}
+			if (v->failed_len < v->failed_alloc) v->failed[v->failed_len++] = job->pos;
+		}
+		v->alloc->free(job);
+		pthread_cond_broadcast(&v->cond);
+	}
+	pthread_mutex_unlock(&v->lock);
+	return NULL;
+}
+
+verify_tt * verify_init(nut_alloc_tt * alloc) {
+	verify_tt * v = alloc->malloc(sizeof(verify_tt));
+	if (!v) return NULL;
+	v->alloc = alloc;
+	v->head = v->tail = NULL;
+	v->pending = 0;
+	v->last_pos = -1;
+	v->failed = NULL;
+	v->failed_len = v->failed_alloc = 0;
+	v->busy = v->quit = 0;
+	if (pthread_mutex_init(&v->lock, NULL)) goto err_out;
+	if (pthread_cond_init(&v->cond, NULL)) goto err_mutex;
+	if (pthread_create(&v->thread, NULL, verify_worker, v)) goto err_cond;
+	return v;
+
+err_cond:
+	pthread_cond_destroy(&v->cond);
+err_mutex:
+	pthread_mutex_destroy(&v->lock);
+err_out:
+	alloc->free(v);
+	return NULL;
+}
+
+void verify_uninit(verify_tt * v) {
+	if (!v) return;
+	pthread_mutex_lock(&v->lock);
+	v->quit = 1;
+	pthread_cond_broadcast(&v->cond);
+	pthread_mutex_unlock(&v->lock);
+	pthread_join(v->thread, NULL);
+	pthread_cond_destroy(&v->cond);
+	pthread_mutex_destroy(&v->lock);
+	v->alloc->free(v->failed);
+	v->alloc->free(v);
+}
+
+int verify_queue(verify_tt * v, const uint8_t * buf, int len, off_t pos, int copy) {
+	verify_job_tt * job;
+	if (pos == v->last_pos) return 0;
+	job = v->alloc->malloc(sizeof(verify_job_tt) + (copy ? len : 0));
+	if (!job) return NUT_ERR_OUT_OF_MEM;
+	job->next = NULL;
+	job->len = len;
+	job->pos = pos;
+	if (copy) {
+		memcpy(job + 1, buf, len);
+		job->data = (uint8_t *)(job + 1);
+	} else job->data = buf;
+
+	pthread_mutex_lock(&v->lock);
+	while (v->pending > MAX_PENDING) pthread_cond_wait(&v->cond, &v->lock);
+	if (v->tail) v->tail->next = job;
+	else v->head = job;
+	v->tail = job;
+	v->pending += len;
+	v->last_pos = pos;
+	pthread_cond_broadcast(&v->cond);
+	pthread_mutex_unlock(&v->lock);
+	return 0;
+}
+
+void verify_sync(verify_tt * v) {
+	pthread_mutex_lock(&v->lock);
+	while (v->head || v->busy) pthread_cond_wait(&v->cond, &v->lock);
+	pthread_mutex_unlock(&v->lock);
+}
+
+int verify_failed(verify_tt * v, off_t * pos) {
+	int ret = 0;
+	pthread_mutex_lock(&v->lock);
+	if (v->failed_len) {
+		*pos = v->failed[0];
+		memmove(v->failed, v->failed + 1, --v->failed_len * sizeof(off_t));
+		ret = 1;
+	}
+	pthread_mutex_unlock(&v->lock);
+	return ret;
+}
@@ -0,0 +1,64 @@
+// (C) 2026 agent
+// This file is available under the MIT/X license, see COPYING
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <time.h>
+#include "libnut.h"
+#include "priv.h"
+
+// Compares the CRC implementations in libnut/crc32.c on buffers of
+// several sizes, from frame headers up to index packets.
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static volatile uint32_t sink; // keeps the calls from being optimized out
+
+static double bench(uint32_t (*crc)(const uint8_t *, int), const uint8_t * buf, int len) {
+	double start = now(), t;
+	long long bytes = 0;
+	do {
+		int i;
+		for (i = 0; i < 1000; i++) sink = crc(buf, len);
+		bytes += 1000LL * len;
+	} while ((t = now() - start) < 0.2);
+	return bytes / t / 1e6;
+}
+
+int main(int argc, char * argv []) {
+	static const int sizes[] = { 16, 64, 256, 4096, 1024*1024 };
+	static const struct { const char * name; uint32_t (*func)(const uint8_t *, int); } crcs[] = {
+		{ "nibble", nut_crc32_nibble },
+		{ "slice8", nut_crc32_slice8 },
+		{ "clmul",  nut_crc32_clmul },
+		{ "auto",   nut_crc32 },
+	};
+	int n = sizeof crcs / sizeof crcs[0];
+	uint8_t * buf = malloc(sizes[4]);
+	int i, j;
+
+	if (!buf) return 1;
+	for (i = 0; i < sizes[4]; i++) buf[i] = rand();
+
+	for (i = 0; i <= 1024; i++) for (j = 1; j < n; j++) {
+		if (crcs[j].func(buf + i%7, i) == nut_crc32_nibble(buf + i%7, i)) continue;
+		printf("%s differs from nibble at %d bytes\n", crcs[j].name, i);
+		return 1;
+	}
+
+	printf("%8s", "bytes");
+	for (j = 0; j < n; j++) printf(" %10s", crcs[j].name);
+	printf("  (MB/s)\n");
+	for (i = 0; i < sizeof sizes / sizeof sizes[0]; i++) {
+		printf("%8d", sizes[i]);
+		for (j = 0; j < n; j++) printf(" %10.0f", bench(crcs[j].func, buf, sizes[i]));
+		printf("\n");
+	}
+	free(buf);
+	return 0;
+}
@@ -0,0 +1,262 @@
+// (C) 2026 agent
+// This file is available under the MIT/X license, see COPYING
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "libnut.h"
+
+// Rebuilds the index of a NUT file that has none, like the ones left
+// behind by a crashed muxer. The file is split into byte ranges and every
+// range is scanned by nut_scan_index() in its own thread and demuxer
+// context. The syncpoint tables are then joined, anything after the last
+// complete frame is cut off, and nut_write_index() appends the headers
+// and an index like nut_muxer_uninit() writes them. The result goes to a
+// temporary file which then replaces the original one.
+
+#define MIN_RANGE (4*1024*1024) // smaller ranges aren't worth a thread
+#define COPY_BLOCK (1024*1024)
+
+typedef struct {
+	int fd;
+	off_t pos;      // of this range's demuxer, the fd is shared
+	off_t start;    // range of the file this thread is responsible for
+	off_t end;      // 0 for the last one
+	int threaded;   // scanned by a thread of its own, not by main()
+	int err;
+	nut_index_tt index;
+} range_tt;
+
+typedef struct {
+	uint8_t * buf;
+	size_t len, alloc_len;
+} buffer_tt;
+
+static size_t range_read(void * priv, size_t len, uint8_t * buf) {
+	range_tt * r = priv;
+	size_t done = 0;
+	while (done < len) {
+		ssize_t got = pread(r->fd, buf + done, len - done, r->pos);
+		if (got <= 0) break;
+		done += got;
+		r->pos += got;
+	}
+	return done;
+}
+
+static off_t range_seek(void * priv, long long pos, int whence) {
+	range_tt * r = priv;
+	if (whence == SEEK_CUR) pos += r->pos;
+	else if (whence == SEEK_END) pos += lseek(r->fd, 0, SEEK_END);
+	return r->pos = pos;
+}
+
+static nut_context_tt * open_range(range_tt * r, nut_stream_header_tt ** s, nut_info_packet_tt ** info) {
+	nut_demuxer_opts_tt dopts = {
+		.input = { .priv = r, .read = range_read, .seek = range_seek, .eof = NULL, .file_pos = 0 },
+		.read_index = 0,
+		.cache_syncpoints = 1,
+		.read_ahead = 256*1024,
+	};
+	nut_context_tt * nut;
+	r->pos = 0;
+	if (!(nut = nut_demuxer_init(&dopts))) {
+		r->err = NUT_ERR_OUT_OF_MEM;
+		return NULL;
+	}
+	if ((r->err = nut_read_headers(nut, s, info))) {
+		nut_demuxer_uninit(nut);
+		return NULL;
+	}
+	return nut;
+}
+
+static void * range_worker(void * priv) {
+	range_tt * r = priv;
+	nut_stream_header_tt * s;
+	nut_context_tt * nut = open_range(r, &s, NULL);
+	if (!nut) return NULL;
+	r->err = nut_scan_index(nut, r->start, r->end, &r->index);
+	nut_demuxer_uninit(nut);
+	return NULL;
+}
+
+static int buffer_write(void * priv, size_t len, const uint8_t * buf) {
+	buffer_tt * bc = priv;
+	if (bc->len + len > bc->alloc_len) {
+		bc->alloc_len = (bc->len + len) * 2;
+		if (!(bc->buf = realloc(bc->buf, bc->alloc_len))) {
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+	}
+	memcpy(bc->buf + bc->len, buf, len);
+	bc->len += len;
+	return len;
+}
+
+static int write_all(int fd, const uint8_t * buf, size_t len) {
+	while (len) {
+		ssize_t n = write(fd, buf, len);
+		if (n <= 0) return 1;
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+// the file up to data_end, then the headers and index
+static int write_file(int fd, int out, off_t data_end, const buffer_tt * tail) {
+	uint8_t * buf = malloc(COPY_BLOCK);
+	off_t pos = 0;
+	int err = 1;
+	if (!buf) return 1;
+	while (pos < data_end) {
+		ssize_t n = pread(fd, buf, data_end - pos < COPY_BLOCK ? data_end - pos : COPY_BLOCK, pos);
+		if (n <= 0 || write_all(out, buf, n)) goto err_out;
+		pos += n;
+	}
+	if (write_all(out, tail->buf, tail->len) || fsync(out)) goto err_out;
+	err = 0;
+err_out:
+	free(buf);
+	return err;
+}
+
+int main(int argc, char * argv[]) {
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int fd = -1, out, n = 0, i, j, len = 0, frames = 0, stream_count;
+	range_tt head = { 0 }, * r = NULL;
+	pthread_t * thread = NULL;
+	nut_stream_header_tt * s;
+	nut_info_packet_tt * info;
+	nut_context_tt * nut = NULL;
+	nut_index_tt index = { 0 };
+	buffer_tt tail = { NULL, 0, 0 };
+	nut_output_stream_tt output = { .priv = &tail, .write = buffer_write };
+	struct stat st;
+	off_t size, data_end = 0;
+	char * tmp_name = NULL;
+	int err = 1;
+
+	if (argc > 2 && !strncmp(argv[1], "-j", 2)) {
+		threads = atoi(argv[1][2] ? argv[1] + 2 : argv[2]);
+		argc -= argv[1][2] ? 1 : 2;
+		argv += argv[1][2] ? 1 : 2;
+	}
+	if (argc != 2 || threads < 1) {
+		fprintf(stderr, "%s [-j threads] <nut-file>\n", argv[0]);
+		fprintf(stderr, "Cuts the file after its last complete frame and appends headers and a new index.\n");
+		fprintf(stderr, "The new file is written next to it and replaces it only once it is complete.\n");
+		return 1;
+	}
+	if ((fd = open(argv[1], O_RDONLY)) == -1 || fstat(fd, &st)) {
+		perror(argv[1]);
+		return 1;
+	}
+	size = st.st_size;
+
+	// the headers are read once more, nut_write_index() writes them from this context
+	head.fd = fd;
+	if (!(nut = open_range(&head, &s, &info))) {
+		fprintf(stderr, "Could not read headers: %s\n", nut_error(head.err));
+		goto err_out;
+	}
+	for (stream_count = 0; s[stream_count].type >= 0; stream_count++);
+
+	n = size / MIN_RANGE < threads ? size / MIN_RANGE : threads;
+	if (n < 1) n = 1;
+	r = calloc(n, sizeof(range_tt));
+	thread = calloc(n, sizeof(pthread_t));
+	if (!r || !thread || !(index.max_pts = calloc(stream_count, sizeof(uint64_t)))) goto err_out;
+	for (i = 0; i < n; i++) {
+		r[i].fd = fd;
+		r[i].start = size / n * i;
+		r[i].end = i == n - 1 ? 0 : size / n * (i + 1);
+	}
+	for (i = 0; i < n; i++) r[i].threaded = !pthread_create(&thread[i], NULL, range_worker, &r[i]);
+	for (i = 0; i < n; i++) {
+		if (r[i].threaded) pthread_join(thread[i], NULL);
+		else range_worker(&r[i]); // no thread could be started for it
+	}
+
+	// join the ranges, a syncpoint at a range boundary is already there from the range before it
+	for (i = 0; i < n; i++) {
+		if (r[i].err) {
+			fprintf(stderr, "Range at %"PRId64": %s\n", (int64_t)r[i].start, nut_error(r[i].err));
+			goto err_out;
+		}
+		len += r[i].index.len;
+	}
+	index.pos = malloc(len * sizeof(off_t) + 1);
+	index.keys = malloc(len * stream_count * sizeof(uint64_t) + 1);
+	index.eor = malloc(len * stream_count * sizeof(uint64_t) + 1);
+	if (!index.pos || !index.keys || !index.eor) goto err_out;
+	for (i = 0; i < n; i++) {
+		nut_index_tt * ri = &r[i].index;
+		for (j = 0; j < ri->len; j++) {
+			if (index.len && ri->pos[j] <= index.pos[index.len - 1]) continue;
+			index.pos[index.len] = ri->pos[j];
+			memcpy(index.keys + index.len * stream_count, ri->keys + j * stream_count, stream_count * sizeof(uint64_t));
+			memcpy(index.eor + index.len * stream_count, ri->eor + j * stream_count, stream_count * sizeof(uint64_t));
+			index.len++;
+		}
+		for (j = 0; j < stream_count; j++) if (ri->max_pts[j] > index.max_pts[j]) index.max_pts[j] = ri->max_pts[j];
+		// a range without frames had no syncpoint, the one before it read through it to EOF
+		if (ri->frames) data_end = ri->data_end;
+		frames += ri->frames;
+	}
+	while (index.len && index.pos[index.len - 1] >= data_end) index.len--; // nothing complete after them
+	if (!frames) {
+		fprintf(stderr, "No frames found\n");
+		goto err_out;
+	}
+
+	if ((i = nut_write_index(nut, &index, &output))) {
+		fprintf(stderr, "Could not write index: %s\n", nut_error(i));
+		goto err_out;
+	}
+
+	printf("%d ranges, %d frames, %d syncpoints\n", n, frames, index.len);
+	if (data_end < size) printf("cutting %"PRId64" bytes after the last frame\n", (int64_t)(size - data_end));
+
+	if (!(tmp_name = malloc(strlen(argv[1]) + 8))) goto err_out;
+	sprintf(tmp_name, "%s.XXXXXX", argv[1]);
+	if ((out = mkstemp(tmp_name)) == -1) {
+		perror(tmp_name);
+		goto err_out;
+	}
+	i = fchmod(out, st.st_mode & 07777) || write_file(fd, out, data_end, &tail);
+	if (close(out) || i || rename(tmp_name, argv[1])) {
+		perror(tmp_name);
+		unlink(tmp_name); // the original file is untouched
+		goto err_out;
+	}
+	printf("headers and index: %d bytes\n", (int)tail.len);
+	err = 0;
+
+err_out:
+	if (r) for (i = 0; i < n; i++) {
+		free(r[i].index.pos);
+		free(r[i].index.keys);
+		free(r[i].index.eor);
+		free(r[i].index.max_pts);
+	}
+	free(r);
+	free(thread);
+	free(index.pos);
+	free(index.keys);
+	free(index.eor);
+	free(index.max_pts);
+	free(tail.buf);
+	free(tmp_name);
+	nut_demuxer_uninit(nut);
+	close(fd);
+	return err;
+}
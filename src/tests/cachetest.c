@@ -0,0 +1,199 @@
+// (C) 2026 agent
+// This file is available under the MIT/X license, see COPYING
+
+#include "common.h"
+
+// Syncpoint cache regression tests, mostly through the sidecar cache of
+// nut_write_syncpoint_cache() and nut_read_syncpoint_cache().
+
+static FILE * write_cache(nut_context_tt * nut) {
+	FILE * c = tmpfile();
+	nut_output_stream_tt o;
+	int err;
+	memset(&o, 0, sizeof o);
+	o.priv = c;
+	if (!c || (err = nut_write_syncpoint_cache(nut, &o))) {
+		printf("could not write the cache: %s\n", c ? nut_error(err) : "tmpfile");
+		exit(1);
+	}
+	fflush(c);
+	return c;
+}
+
+static int same_file(FILE * a, FILE * b) {
+	int x, y;
+	rewind(a);
+	rewind(b);
+	do {
+		x = getc(a);
+		y = getc(b);
+	} while (x == y && x != EOF);
+	return x == y;
+}
+
+static int read_cache(nut_context_tt * nut, FILE * c) {
+	nut_input_stream_tt in;
+	memset(&in, 0, sizeof in);
+	in.priv = c;
+	rewind(c);
+	return nut_read_syncpoint_cache(nut, &in);
+}
+
+static nut_context_tt * demux(FILE * f, int read_index) {
+	nut_demuxer_opts_tt dopts;
+	demux_opts(f, &dopts);
+	dopts.read_index = read_index;
+	return demux_init(&dopts);
+}
+
+// the cache of a context that has seen every syncpoint, and seeked once to
+// know that the last one is the last
+static FILE * played_cache(FILE * f, int read_index) {
+	nut_context_tt * nut = demux(f, read_index);
+	nut_packet_tt p;
+	FILE * c;
+	int err;
+	if ((err = first_packet(nut, -1, &p)) != NUT_ERR_EOF || (err = nut_seek(nut, 170, 0, NULL))) {
+		printf("playback: %s\n", nut_error(err));
+		exit(1);
+	}
+	c = write_cache(nut);
+	nut_demuxer_uninit(nut);
+	return c;
+}
+
+static int test_play_eagain(void) {
+	// playing a file with reads cut short fills the cache like complete reads do
+	FILE * f = mux(12000, 0), * c[2];
+	nut_packet_tt p;
+	int i, err, ret = 0;
+
+	for (i = 0; i < 2; i++) {
+		nut_demuxer_opts_tt dopts;
+		nut_context_tt * nut;
+		starve_tt in;
+		starve_opts(f, &in, &dopts);
+		nut = demux_init(&dopts);
+		in.on = i;
+		if ((err = first_packet(nut, -1, &p)) != NUT_ERR_EOF) {
+			printf("playback with EAGAIN %d: %s\n", i, nut_error(err));
+			ret = 1;
+		}
+		c[i] = write_cache(nut);
+		nut_demuxer_uninit(nut);
+	}
+	if (!ret && !same_file(c[0], c[1])) {
+		printf("the cache differs after EAGAIN\n");
+		ret = 1;
+	}
+	fclose(c[0]);
+	fclose(c[1]);
+	fclose(f);
+	return ret;
+}
+
+static int test_seek_order(void) {
+	// Syncpoints found by seeks in any order, then by playing the file, are
+	// cached like those found by playing it only. So are those of the index
+	// once the file was played.
+	static const double t[] = { 150, 3, 90.5, 170, 40, 41, 0.5, 120, 60 };
+	FILE * f = mux(12000, 1), * c[3];
+	nut_context_tt * nut = demux(f, 0);
+	nut_packet_tt p;
+	int i, err, ret = 0;
+
+	for (i = 0; i < sizeof t / sizeof t[0] && !ret; i++) {
+		if ((err = nut_seek(nut, t[i], 0, NULL)) || (err = first_packet(nut, 0, &p))) {
+			printf("seek to %.1f: %s\n", t[i], nut_error(err));
+			ret = 1;
+		}
+	}
+	if ((err = nut_seek(nut, 0, 0, NULL)) || (err = first_packet(nut, -1, &p)) != NUT_ERR_EOF) {
+		printf("playback after seeking: %s\n", nut_error(err));
+		ret = 1;
+	}
+	c[0] = write_cache(nut);
+	nut_demuxer_uninit(nut);
+	c[1] = played_cache(f, 0);
+	c[2] = played_cache(f, 1);
+	if (!ret && !same_file(c[0], c[1])) {
+		printf("the cache differs after seeking\n");
+		ret = 1;
+	}
+	if (!ret && !same_file(c[2], c[1])) {
+		printf("the cache of the index differs\n");
+		ret = 1;
+	}
+	for (i = 0; i < 3; i++) fclose(c[i]);
+	fclose(f);
+	return ret;
+}
+
+// hashes of the frames after a few seeks
+static const double seek_to[] = { 100, 25.7, 170, 3, 0, 150.2, 60 };
+enum { SEEKS = sizeof seek_to / sizeof seek_to[0] };
+
+static int seek_frames(nut_context_tt * nut, uint32_t * sum) {
+	int i, err;
+	for (i = 0; i < SEEKS; i++) {
+		sum[i] = 2166136261u;
+		if ((err = nut_seek(nut, seek_to[i], 0, NULL))) {
+			printf("seek to %.1f: %s\n", seek_to[i], nut_error(err));
+			return 1;
+		}
+		if (play(nut, READ_FRAME, 100, &sum[i]) != 100) {
+			printf("could not read 100 frames after seeking to %.1f\n", seek_to[i]);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int test_round_trip(void) {
+	// A loaded cache is written again as it was, and seeks with it land
+	// where they do with the index. It does not load for another file.
+	FILE * f = mux(12000, 1), * g = mux(11000, 1), * c = played_cache(f, 0), * d = NULL;
+	nut_context_tt * nut = demux(f, 0);
+	uint32_t a[SEEKS], b[SEEKS];
+	int i, err, ret = 0;
+
+	if ((err = read_cache(nut, c))) {
+		printf("could not read the cache: %s\n", nut_error(err));
+		ret = 1;
+	} else if (!same_file(c, d = write_cache(nut))) {
+		printf("the cache differs after reading it\n");
+		ret = 1;
+	}
+	ret = ret || seek_frames(nut, a);
+	nut_demuxer_uninit(nut);
+	if (!ret) { // the contexts share f, one at a time
+		nut = demux(f, 1);
+		ret = seek_frames(nut, b);
+		nut_demuxer_uninit(nut);
+	}
+	for (i = 0; i < SEEKS && !ret; i++) {
+		if (a[i] == b[i]) continue;
+		printf("seek to %.1f landed elsewhere than with the index\n", seek_to[i]);
+		ret = 1;
+	}
+	nut = demux(g, 0);
+	if (!ret && (err = read_cache(nut, c)) != NUT_ERR_CACHE_MISMATCH) {
+		printf("the cache of another file: %s\n", nut_error(err));
+		ret = 1;
+	}
+	nut_demuxer_uninit(nut);
+	fclose(c);
+	if (d) fclose(d);
+	fclose(f);
+	fclose(g);
+	return ret;
+}
+
+int main(void) {
+	static const test_tt tests[] = {
+		{ "play_eagain", test_play_eagain },
+		{ "seek_order", test_seek_order },
+		{ "round_trip", test_round_trip },
+	};
+	return run_tests(tests, sizeof tests / sizeof tests[0]);
+}
@@ -0,0 +1,214 @@
+// (C) 2026 agent
+// This file is available under the MIT/X license, see COPYING
+
+#include "common.h"
+
+// Helpers shared by the regression tests. The test file has a video stream
+// with B-frames and a keyframe every 48 frames, an audio stream of
+// keyframes only and a sparse subtitle stream, some of whose frames are
+// EOR frames.
+
+static unsigned seed;
+static nut_stats_tt last_stats;
+static nut_stream_stats_tt last_streams[3];
+static unsigned rnd(void) { seed = seed * 1103515245u + 12345u; return seed >> 8; }
+
+static FILE * mux_any(int frames, int write_index, nut_timebase_tt tb, int64_t ticks, nut_frame_table_input_tt * fti);
+
+FILE * mux(int frames, int write_index) {
+	nut_timebase_tt tb = { 1001, 30000 };
+	return mux_any(frames, write_index, tb, 1, NULL);
+}
+
+FILE * mux_video_tb(int frames, int write_index, nut_timebase_tt tb, int64_t ticks) {
+	return mux_any(frames, write_index, tb, ticks, NULL);
+}
+
+FILE * mux_fti(int frames, nut_frame_table_input_tt * fti) {
+	nut_timebase_tt tb = { 1001, 30000 };
+	return mux_any(frames, 0, tb, 1, fti);
+}
+
+static FILE * mux_any(int frames, int write_index, nut_timebase_tt tb, int64_t ticks, nut_frame_table_input_tt * fti) {
+	FILE * f = tmpfile();
+	nut_muxer_opts_tt mo;
+	nut_stream_header_tt s[4];
+	nut_context_tt * nut;
+	uint64_t ap = 0, sp = 500;
+	int i, vi = 0;
+	uint8_t * buf = malloc(30000);
+
+	if (!f || !buf) exit(1);
+	memset(&mo, 0, sizeof mo);
+	mo.output.priv = f;
+	mo.write_index = write_index;
+	mo.max_distance = 32768;
+	mo.fti = fti;
+	memset(s, 0, sizeof s);
+	s[0].type = NUT_VIDEO_CLASS; s[0].fourcc = (uint8_t *)"mp4v"; s[0].fourcc_len = 4;
+	s[0].time_base = tb; s[0].fixed_fps = 1; s[0].decode_delay = 2;
+	s[0].width = 320; s[0].height = 240; s[0].sample_width = 1; s[0].sample_height = 1;
+	s[1].type = NUT_AUDIO_CLASS; s[1].fourcc = (uint8_t *)"mp3 "; s[1].fourcc_len = 4;
+	s[1].time_base.num = 1152; s[1].time_base.den = 44100; s[1].fixed_fps = 1;
+	s[1].samplerate_num = 44100; s[1].samplerate_denom = 1; s[1].channel_count = 2;
+	s[2].type = NUT_SUBTITLE_CLASS; s[2].fourcc = (uint8_t *)"text"; s[2].fourcc_len = 4;
+	s[2].time_base.num = 1; s[2].time_base.den = 1000;
+	s[3].type = -1;
+
+	seed = 1;
+	nut = nut_muxer_init(&mo, s, NULL);
+	for (i = 0; i < frames; i++) {
+		static const int order[4] = { 0, 3, 1, 2 };
+		double vt = (vi - 2) * (double)ticks * tb.num / tb.den, at = AUDIO_TB(ap), st = sp / 1000.0;
+		nut_packet_tt p;
+		int j;
+		memset(&p, 0, sizeof p);
+		if (vt <= at && vt <= st) {
+			p.stream = 0;
+			p.pts = (vi / 4 * 4 + order[vi % 4]) * ticks;
+			p.flags = vi++ % 48 ? 0 : NUT_FLAG_KEY;
+			p.len = (p.flags ? 20000 : 200) + rnd() % 3000;
+		} else if (at <= st) {
+			p.stream = 1;
+			p.pts = ap++;
+			p.flags = NUT_FLAG_KEY;
+			p.len = 417 + rnd() % 2;
+		} else {
+			p.stream = 2;
+			p.pts = sp;
+			p.flags = NUT_FLAG_KEY;
+			p.len = rnd() % 50 + 1;
+			if (rnd() % 5 == 0) { p.flags |= NUT_FLAG_EOR; p.len = 0; }
+			sp += 1000 + rnd() % 4000;
+		}
+		for (j = 0; j < p.len; j++) buf[j] = rnd();
+		nut_write_frame(nut, &p, buf);
+	}
+	nut_get_stats(nut, &last_stats);
+	memcpy(last_streams, last_stats.streams, sizeof last_streams);
+	last_stats.streams = last_streams;
+	nut_muxer_uninit(nut);
+	free(buf);
+	return f;
+}
+
+void mux_stats(nut_stats_tt * stats) {
+	*stats = last_stats;
+}
+
+void demux_opts(FILE * f, nut_demuxer_opts_tt * dopts) {
+	memset(dopts, 0, sizeof *dopts);
+	rewind(f);
+	dopts->input.priv = f;
+	dopts->cache_syncpoints = 1;
+}
+
+static size_t starve_read(void * priv, size_t len, uint8_t * buf) {
+	starve_tt * in = priv;
+	in->seed = in->seed * 1103515245u + 12345u;
+	if ((in->starved = in->on && (in->seed >> 8) % 3 == 0)) {
+		len = (in->seed >> 12) % (len / 2 + 1);
+		in->eagain++;
+	}
+	return fread(buf, 1, len, in->f);
+}
+
+static off_t starve_seek(void * priv, long long pos, int whence) {
+	starve_tt * in = priv;
+	fseeko(in->f, pos, whence);
+	return ftello(in->f);
+}
+
+static int starve_eof(void * priv) {
+	starve_tt * in = priv;
+	return !in->starved;
+}
+
+void starve_opts(FILE * f, starve_tt * in, nut_demuxer_opts_tt * dopts) {
+	demux_opts(f, dopts);
+	memset(in, 0, sizeof *in);
+	in->f = f;
+	in->seed = 1;
+	dopts->input.priv = in;
+	dopts->input.read = starve_read;
+	dopts->input.seek = starve_seek;
+	dopts->input.eof = starve_eof;
+}
+
+nut_context_tt * demux_init(nut_demuxer_opts_tt * dopts) {
+	nut_stream_header_tt * s;
+	nut_context_tt * nut = nut_demuxer_init(dopts);
+	if (!nut || nut_read_headers(nut, &s, NULL)) {
+		printf("could not read the headers\n");
+		exit(1);
+	}
+	return nut;
+}
+
+int first_packet(nut_context_tt * nut, int stream, nut_packet_tt * p) {
+	const uint8_t * buf;
+	int err;
+	for (;;) {
+		while ((err = nut_read_next_packet(nut, p)) == NUT_ERR_EAGAIN);
+		if (err) break;
+		while ((err = nut_read_frame_ref(nut, p->len, &buf)) == NUT_ERR_EAGAIN);
+		if (err || p->stream == stream) break;
+	}
+	return err;
+}
+
+static uint32_t hash(uint32_t h, const void * data, size_t len) {
+	const uint8_t * p = data;
+	while (len--) h = (h ^ *p++) * 16777619u; // FNV-1a
+	return h;
+}
+
+static uint32_t hash_frame(uint32_t h, const nut_packet_tt * p, const uint8_t * buf) {
+	h = hash(h, &p->stream, sizeof p->stream);
+	h = hash(h, &p->pts, sizeof p->pts);
+	h = hash(h, &p->flags, sizeof p->flags);
+	h = hash(h, &p->len, sizeof p->len);
+	return hash(h, buf, p->len);
+}
+
+int play(nut_context_tt * nut, int how, int max, uint32_t * sum) {
+	nut_packet_tt p[32];
+	const uint8_t * data[32];
+	uint8_t * buf = NULL;
+	int i, len, count, err = 0, frames = 0;
+	while (!max || frames < max) {
+		if (how == READ_PACKETS) {
+			int n = max && max - frames < 32 ? max - frames : 32;
+			while ((err = nut_read_packets(nut, p, data, n, &count)) == NUT_ERR_EAGAIN);
+			if (err) break;
+			for (i = 0; i < count; i++) *sum = hash_frame(*sum, &p[i], data[i]);
+			frames += count;
+			continue;
+		}
+		while ((err = nut_read_next_packet(nut, p)) == NUT_ERR_EAGAIN);
+		if (err) break;
+		if (how == READ_FRAME_REF) {
+			while ((err = nut_read_frame_ref(nut, p->len, data)) == NUT_ERR_EAGAIN);
+		} else {
+			if (!(buf = realloc(buf, p->len + 1))) exit(1);
+			len = p->len;
+			while ((err = nut_read_frame(nut, &len, buf + p->len - len)) == NUT_ERR_EAGAIN);
+			data[0] = buf;
+		}
+		if (err) break;
+		*sum = hash_frame(*sum, p, data[0]);
+		frames++;
+	}
+	free(buf);
+	return err && err != NUT_ERR_EOF ? -1 : frames;
+}
+
+int run_tests(const test_tt * tests, int count) {
+	int i, failed = 0;
+	for (i = 0; i < count; i++) {
+		int ret = tests[i].func();
+		printf("%-20s %s\n", tests[i].name, ret ? "FAIL" : "ok");
+		failed += ret;
+	}
+	return !!failed;
+}
@@ -0,0 +1,62 @@
+// (C) 2026 agent
+// This file is available under the MIT/X license, see COPYING
+
+#ifndef TESTS_COMMON_H
+#define TESTS_COMMON_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <libnut.h>
+
+#define AUDIO_TB(pts) ((pts) * 1152.0 / 44100)
+
+typedef struct {
+	const char * name;
+	int (*func)(void);
+} test_tt;
+
+/// Muxes \a frames frames of a video, an audio and a subtitle stream into a temporary file.
+FILE * mux(int frames, int write_index);
+
+/// Like mux(), but the video timebase is \a tb, and a video frame lasts \a ticks of it instead of 1001/30000 seconds.
+FILE * mux_video_tb(int frames, int write_index, nut_timebase_tt tb, int64_t ticks);
+
+/// Like mux(), but with the framecode table \a fti.
+FILE * mux_fti(int frames, nut_frame_table_input_tt * fti);
+
+/// Counters of the last muxed file, before nut_muxer_uninit() repeated the headers and wrote the index.
+void mux_stats(nut_stats_tt * stats);
+
+/// input that reads from a file in short pieces, with EAGAIN in between
+typedef struct {
+	FILE * f;
+	int on;        ///< reads are only cut short while this is set, nut_read_headers() needs it unset
+	unsigned seed;
+	int starved;   ///< the last read was cut short, eof() says there is more
+	int eagain;    ///< times a read was cut short
+} starve_tt;
+
+/// demuxer options reading from \a f from its start, with the syncpoint cache on
+void demux_opts(FILE * f, nut_demuxer_opts_tt * dopts);
+
+/// Like demux_opts(), but \a in reads from \a f and cuts every third read or so short once \a in->on is set.
+void starve_opts(FILE * f, starve_tt * in, nut_demuxer_opts_tt * dopts);
+
+/// Opens a demuxer and reads the headers, exits if that fails.
+nut_context_tt * demux_init(nut_demuxer_opts_tt * dopts);
+
+/// Reads up to the next frame of \a stream, any stream if it is -1. Reads that give EAGAIN are repeated.
+int first_packet(nut_context_tt * nut, int stream, nut_packet_tt * p);
+
+/// ways of reading frames for play()
+enum { READ_FRAME, READ_FRAME_REF, READ_PACKETS };
+
+/// Reads up to \a max frames, all of them if it is 0, hashing their headers and data into \a sum. Reads that give EAGAIN are repeated. Returns the frames read, -1 after an error other than EOF.
+int play(nut_context_tt * nut, int how, int max, uint32_t * sum);
+
+/// Runs the tests and prints their results, returns non-zero if any failed.
+int run_tests(const test_tt * tests, int count);
+
+#endif // TESTS_COMMON_H
@@ -0,0 +1,67 @@
+// (C) 2026 agent
+// This file is available under the MIT/X license, see COPYING
+
+#include "common.h"
+#include "priv.h"
+
+// CRC-32 regression tests. The faster implementations must agree with the
+// nibble table one for any length and alignment.
+
+#define BUF_LEN (64*1024 + 64)
+
+static const struct { const char * name; uint32_t (*crc32)(const uint8_t * buf, int len); } impl[] = {
+	{ "slice8", nut_crc32_slice8 },
+	{ "clmul",  nut_crc32_clmul },
+	{ "auto",   nut_crc32 },
+};
+enum { IMPLS = sizeof impl / sizeof impl[0] };
+
+static int check(const uint8_t * buf, int len) {
+	uint32_t crc = nut_crc32_nibble(buf, len);
+	int i;
+	for (i = 0; i < IMPLS; i++) {
+		uint32_t c = impl[i].crc32(buf, len);
+		if (c == crc) continue;
+		printf("%s: %08"PRIX32" instead of %08"PRIX32" for %d bytes at alignment %d\n", impl[i].name, c, crc, len, (int)((uintptr_t)buf & 63));
+		return 1;
+	}
+	return 0;
+}
+
+static int test_lengths(void) {
+	// every short length at every alignment, then random ones
+	uint8_t * buf = malloc(BUF_LEN);
+	int i, j, ret = 0;
+	if (!buf) return 1;
+	srand(1);
+	for (i = 0; i < BUF_LEN; i++) buf[i] = rand();
+	for (i = 0; i <= 300 && !ret; i++) for (j = 0; j < 64 && !ret; j++) ret = check(buf + j, i);
+	for (i = 0; i < 2000 && !ret; i++) ret = check(buf + rand() % 64, rand() % (BUF_LEN - 64));
+	free(buf);
+	return ret;
+}
+
+static int test_append(void) {
+	// appending the checksum big-endian makes the one of the whole buffer 0
+	uint8_t buf[1000 + 4];
+	int i, len, ret = 0;
+	srand(2);
+	for (i = 0; i < sizeof buf; i++) buf[i] = rand();
+	for (len = 0; len <= 1000 && !ret; len += 37) {
+		uint32_t crc = nut_crc32(buf, len);
+		buf[len] = crc >> 24; buf[len + 1] = crc >> 16; buf[len + 2] = crc >> 8; buf[len + 3] = crc;
+		if ((crc = nut_crc32(buf, len + 4))) {
+			printf("%d bytes and their checksum: %08"PRIX32"\n", len, crc);
+			ret = 1;
+		}
+	}
+	return ret;
+}
+
+int main(void) {
+	static const test_tt tests[] = {
+		{ "lengths", test_lengths },
+		{ "append", test_append },
+	};
+	return run_tests(tests, sizeof tests / sizeof tests[0]);
+}
@@ -0,0 +1,194 @@
+// (C) 2026 agent
+// This file is available under the MIT/X license, see COPYING
+
+#include "common.h"
+
+// Damaged file regression tests.
+
+#define FRAMES 12000
+
+static const uint8_t syncpoint_startcode[8] = { 'N', 'K', 0xE4, 0xAD, 0xEE, 0xCA, 0x45, 0x69 };
+
+typedef struct {
+	uint8_t * data;
+	long len;
+} file_tt;
+
+static file_tt load(FILE * f) {
+	file_tt m;
+	fseek(f, 0, SEEK_END);
+	m.len = ftell(f);
+	if (!(m.data = malloc(m.len))) exit(1);
+	rewind(f);
+	if (fread(m.data, 1, m.len, f) != m.len) exit(1);
+	return m;
+}
+
+static FILE * save(const file_tt * m) {
+	FILE * f = tmpfile();
+	if (!f || fwrite(m->data, 1, m->len, f) != m->len) exit(1);
+	fflush(f);
+	return f;
+}
+
+// positions of the syncpoints, up to max of them
+static int find_syncpoints(const file_tt * m, long * pos, int max) {
+	int n = 0;
+	long i;
+	for (i = 0; i + 8 <= m->len && n < max; i++) if (!memcmp(m->data + i, syncpoint_startcode, 8)) pos[n++] = i;
+	return n;
+}
+
+// stream and pts of every frame up to EOF, returns how many there were or -1 after another error
+static int frames(nut_context_tt * nut, uint64_t * list) {
+	nut_packet_tt p;
+	const uint8_t * buf;
+	int err, n = 0;
+	while (!(err = nut_read_next_packet(nut, &p)) && !(err = nut_read_frame_ref(nut, p.len, &buf))) {
+		if (n < FRAMES) list[n] = p.pts << 2 | p.stream;
+		n++;
+	}
+	return err == NUT_ERR_EOF ? n : -1;
+}
+
+// damaged has the frames of clean, except for a single run of at most max frames
+static int lost_frames(const uint64_t * clean, int n, const uint64_t * damaged, int m, int max) {
+	int head = 0, tail = 0;
+	if (m > n || n - m > max) return -1;
+	while (head < m && damaged[head] == clean[head]) head++;
+	while (tail < m - head && damaged[m - 1 - tail] == clean[n - 1 - tail]) tail++;
+	return head + tail == m ? n - m : -1;
+}
+
+static int test_lost_syncpoint(void) {
+	// a damaged syncpoint startcode costs the frames up to the next one, whatever
+	// its alignment in memory and in the file
+	FILE * f = mux(FRAMES, 0);
+	file_tt m = load(f);
+	long pos[64];
+	uint64_t * clean = malloc(2 * FRAMES * sizeof(uint64_t)), * damaged = clean + FRAMES;
+	int i, n, lost, count, ret = 0;
+	nut_demuxer_opts_tt dopts;
+	nut_context_tt * nut;
+
+	demux_opts(f, &dopts);
+	nut = demux_init(&dopts);
+	count = frames(nut, clean);
+	nut_demuxer_uninit(nut);
+	n = find_syncpoints(&m, pos, 64);
+	if (count != FRAMES || n < 64) {
+		printf("%d frames and %d syncpoints in the clean file\n", count, n);
+		ret = 1;
+	}
+	for (i = 1; i < n && !ret; i++) { // the first syncpoint is needed to start
+		FILE * g;
+		nut_stats_tt stats;
+		m.data[pos[i] + 1] ^= 0x10;
+		g = save(&m);
+		m.data[pos[i] + 1] ^= 0x10;
+		demux_opts(g, &dopts);
+		nut = demux_init(&dopts);
+		count = frames(nut, damaged);
+		nut_get_stats(nut, &stats);
+		if (count < 0 || (lost = lost_frames(clean, FRAMES, damaged, count, 1000)) < 0) {
+			printf("syncpoint %d at %ld damaged: %d frames, not the clean ones\n", i, pos[i], count);
+			ret = 1;
+		} else if (!stats.resyncs) {
+			printf("syncpoint %d at %ld damaged: %d frames lost without a resync\n", i, pos[i], lost);
+			ret = 1;
+		}
+		nut_demuxer_uninit(nut);
+		fclose(g);
+	}
+	free(clean);
+	free(m.data);
+	fclose(f);
+	return ret;
+}
+
+// where the checked part of the syncpoint at pos starts, after its forward_ptr
+static long syncpoint_body(const file_tt * m, long pos, int * forward_ptr) {
+	long i = pos + 8;
+	*forward_ptr = 0;
+	do *forward_ptr = *forward_ptr << 7 | (m->data[i] & 0x7F); while (m->data[i++] & 0x80);
+	return i;
+}
+
+typedef struct {
+	int count;
+	off_t pos;
+} bad_checksum_tt;
+
+static void bad_checksum(void * priv, off_t pos) {
+	bad_checksum_tt * b = priv;
+	b->count++;
+	b->pos = pos;
+}
+
+static int test_checksums(void) {
+	// A syncpoint with a bad checksum is dropped in strict mode. In
+	// deferred mode it is reported and, like in trusted mode, used.
+	static const int which[] = { 1, 2, 17, 40, 63 };
+	static const char * names[] = { "strict", "deferred", "trusted" };
+	FILE * f = mux(FRAMES, 0);
+	file_tt m = load(f);
+	long pos[64];
+	uint64_t * clean = malloc(2 * FRAMES * sizeof(uint64_t)), * damaged = clean + FRAMES;
+	int i, mode, count, lost, ret = 0;
+	nut_demuxer_opts_tt dopts;
+	nut_context_tt * nut;
+
+	demux_opts(f, &dopts);
+	nut = demux_init(&dopts);
+	count = frames(nut, clean);
+	nut_demuxer_uninit(nut);
+	if (count != FRAMES || find_syncpoints(&m, pos, 64) < 64) {
+		printf("%d frames in the clean file\n", count);
+		ret = 1;
+	}
+	for (i = 0; i < sizeof which / sizeof which[0] && !ret; i++) {
+		int forward_ptr;
+		long body = syncpoint_body(&m, pos[which[i]], &forward_ptr);
+		FILE * g;
+		m.data[body + forward_ptr - 1] ^= 0x01;
+		g = save(&m);
+		m.data[body + forward_ptr - 1] ^= 0x01;
+		for (mode = NUT_CHECKSUM_STRICT; mode <= NUT_CHECKSUM_TRUSTED && !ret; mode++) {
+			bad_checksum_tt b = { 0, 0 };
+			nut_stats_tt stats;
+			demux_opts(g, &dopts);
+			dopts.checksums = mode;
+			dopts.checksum_priv = &b;
+			dopts.bad_checksum = bad_checksum;
+			nut = demux_init(&dopts);
+			count = frames(nut, damaged);
+			nut_get_stats(nut, &stats);
+			nut_demuxer_uninit(nut); // reports the last deferred failures
+			lost = count < 0 ? -1 : lost_frames(clean, FRAMES, damaged, count, mode == NUT_CHECKSUM_STRICT ? 1000 : 0);
+			if (lost < 0) {
+				printf("%d frames, not the clean ones\n", count);
+				ret = 1;
+			} else if (mode == NUT_CHECKSUM_STRICT && !stats.resyncs) {
+				printf("%d frames lost without a resync\n", lost);
+				ret = 1;
+			} else if (b.count != (mode == NUT_CHECKSUM_DEFERRED) || (b.count && b.pos != body)) {
+				printf("%d bad checksums reported, the last at %"PRId64"\n", b.count, (int64_t)b.pos);
+				ret = 1;
+			}
+			if (ret) printf("checksum of syncpoint %d at %ld damaged, %s checksums\n", which[i], pos[which[i]], names[mode]);
+		}
+		fclose(g);
+	}
+	free(clean);
+	free(m.data);
+	fclose(f);
+	return ret;
+}
+
+int main(void) {
+	static const test_tt tests[] = {
+		{ "lost_syncpoint", test_lost_syncpoint },
+		{ "checksums", test_checksums },
+	};
+	return run_tests(tests, sizeof tests / sizeof tests[0]);
+}
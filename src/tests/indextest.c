@@ -0,0 +1,102 @@
+// (C) 2026 agent
+// This file is available under the MIT/X license, see COPYING
+
+#include "common.h"
+
+// Index rebuilding regression tests, for nut_scan_index() and
+// nut_write_index().
+
+static int test_scan_index(void) {
+	// an index written for a file muxed without one is what the muxer writes with it
+	FILE * f = mux(12000, 0), * g = mux(12000, 1), * out = tmpfile();
+	nut_demuxer_opts_tt dopts;
+	nut_context_tt * nut;
+	nut_output_stream_tt o;
+	nut_index_tt index;
+	int a, b, err, ret = 0;
+
+	demux_opts(f, &dopts);
+	nut = demux_init(&dopts);
+	memset(&o, 0, sizeof o);
+	o.priv = out;
+	memset(&index, 0, sizeof index);
+	if ((err = nut_scan_index(nut, 0, 0, &index))) {
+		printf("scan: %s\n", nut_error(err));
+		ret = 1;
+	} else if ((err = nut_write_index(nut, &index, &o))) {
+		printf("write: %s\n", nut_error(err));
+		ret = 1;
+	} else {
+		fflush(out);
+		rewind(out);
+		fseek(g, index.data_end, SEEK_SET);
+		do {
+			a = getc(out);
+			b = getc(g);
+		} while (a == b && a != EOF);
+		if (a != b) {
+			printf("headers and index differ at %ld, after %d frames\n", ftell(g), index.frames);
+			ret = 1;
+		}
+	}
+	free(index.pos);
+	free(index.keys);
+	free(index.eor);
+	free(index.max_pts);
+	nut_demuxer_uninit(nut);
+	fclose(f);
+	fclose(g);
+	fclose(out);
+	return ret;
+}
+
+static int fail_alloc;
+
+static void * failing_malloc(size_t size) { return fail_alloc ? NULL : malloc(size); }
+static void * failing_realloc(void * ptr, size_t size) { return fail_alloc ? NULL : realloc(ptr, size); }
+
+static int test_write_index_oom(void) {
+	// out of memory, an error is given and nothing is written
+	FILE * f = mux(2000, 0), * out = tmpfile();
+	nut_demuxer_opts_tt dopts;
+	nut_context_tt * nut;
+	nut_output_stream_tt o;
+	nut_index_tt index;
+	int err, ret = 0;
+
+	demux_opts(f, &dopts);
+	dopts.alloc = (nut_alloc_tt){ failing_malloc, failing_realloc, free };
+	nut = demux_init(&dopts);
+	memset(&o, 0, sizeof o);
+	o.priv = out;
+	memset(&index, 0, sizeof index);
+	if ((err = nut_scan_index(nut, 0, 0, &index))) {
+		printf("scan: %s\n", nut_error(err));
+		ret = 1;
+	} else {
+		fail_alloc = 1;
+		err = nut_write_index(nut, &index, &o);
+		fail_alloc = 0;
+		fflush(out);
+		if (err != NUT_ERR_OUT_OF_MEM || ftell(out)) {
+			printf("write: %s, %ld bytes written\n", nut_error(err), ftell(out));
+			ret = 1;
+		}
+	}
+	free(index.pos);
+	free(index.keys);
+	free(index.eor);
+	free(index.max_pts);
+	nut_demuxer_uninit(nut);
+	fclose(f);
+	fclose(out);
+	return ret;
+}
+
+int main(void) {
+	static const test_tt tests[] = {
+		{ "scan_index", test_scan_index },
+		{ "write_index_oom", test_write_index_oom },
+	};
+	return run_tests(tests, sizeof tests / sizeof tests[0]);
+}
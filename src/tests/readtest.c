@@ -0,0 +1,436 @@
+// (C) 2026 agent
+// This file is available under the MIT/X license, see COPYING
+
+#include "common.h"
+
+// Input and frame reading regression tests. Every way of getting frames
+// out of a file must give the same frames as plain buffered reads do.
+
+#define FRAMES 12000
+
+static const double seek_to[] = { 100, 25.7, 170, 3, 0, 150.2, 60 }; // the file is 175s long
+enum { SEEKS = sizeof seek_to / sizeof seek_to[0] };
+
+// plays the whole file, then reads some frames after each of a few seeks
+static int walk(nut_demuxer_opts_tt * dopts, starve_tt * in, int how, uint32_t * sum) {
+	nut_context_tt * nut = demux_init(dopts);
+	int i, err = 0, frames;
+	if (in) in->on = 1;
+	*sum = 2166136261u;
+	if ((frames = play(nut, how, 0, sum)) != FRAMES) {
+		printf("played %d frames of %d\n", frames, FRAMES);
+		err = 1;
+	}
+	for (i = 0; i < SEEKS && !err; i++) {
+		while ((err = nut_seek(nut, seek_to[i], 0, NULL)) == NUT_ERR_EAGAIN);
+		if (err) printf("seek to %.1f: %s\n", seek_to[i], nut_error(err));
+		else if (play(nut, how, 200, sum) != 200) {
+			printf("could not read 200 frames after seeking to %.1f\n", seek_to[i]);
+			err = 1;
+		}
+	}
+	if (!err && in && !in->eagain) {
+		printf("no read was cut short\n");
+		err = 1;
+	}
+	nut_demuxer_uninit(nut);
+	return err;
+}
+
+// the frames of a plain FILE * input read with nut_read_frame()
+static int reference(FILE * f, uint32_t * sum) {
+	nut_demuxer_opts_tt dopts;
+	demux_opts(f, &dopts);
+	return walk(&dopts, NULL, READ_FRAME, sum);
+}
+
+// FILE * input that checks the reads libnut asks for
+typedef struct {
+	FILE * f;
+	int align, min; // every read that is not cut short by EOF should end aligned and be this long
+	int reads, bad;
+	off_t size;     // hints must be inside the file
+	int hints, bad_hints;
+} watch_tt;
+
+static size_t watch_read(void * priv, size_t len, uint8_t * buf) {
+	watch_tt * w = priv;
+	off_t end = ftello(w->f) + len;
+	size_t n = fread(buf, 1, len, w->f);
+	w->reads++;
+	if (n == len && ((w->align && end % w->align) || len < w->min)) w->bad++;
+	return n;
+}
+
+static off_t watch_seek(void * priv, long long pos, int whence) {
+	watch_tt * w = priv;
+	fseeko(w->f, pos, whence);
+	return ftello(w->f);
+}
+
+static void watch_hint(void * priv, off_t pos, size_t len) {
+	watch_tt * w = priv;
+	w->hints++;
+	if (pos < 0 || !len || pos + len > w->size) w->bad_hints++;
+}
+
+static void watch_opts(FILE * f, watch_tt * w, nut_demuxer_opts_tt * dopts) {
+	demux_opts(f, dopts);
+	memset(w, 0, sizeof *w);
+	w->f = f;
+	dopts->input.priv = w;
+	dopts->input.read = watch_read;
+	dopts->input.seek = watch_seek;
+}
+
+// compares what walk() gives with dopts to the reference
+static int compare(FILE * f, nut_demuxer_opts_tt * dopts, starve_tt * in, int how, const char * what) {
+	uint32_t a, b;
+	int ret = reference(f, &a);
+	rewind(f); // where dopts expects it
+	if (!ret && !(ret = walk(dopts, in, how, &b)) && a != b) {
+		printf("%s gives other frames\n", what);
+		ret = 1;
+	}
+	return ret;
+}
+
+static int test_mmap(void) {
+	FILE * f = mux(FRAMES, 0);
+	nut_demuxer_opts_tt dopts;
+	nut_context_tt * nut;
+	nut_stats_tt stats;
+	uint32_t a;
+	int ret;
+	demux_opts(f, &dopts);
+	dopts.mmap_input = 1;
+	ret = compare(f, &dopts, NULL, READ_FRAME_REF, "memory mapped input");
+	nut = demux_init(&dopts);
+	play(nut, READ_FRAME, 100, &a);
+	nut_get_stats(nut, &stats);
+	if (stats.buffer_high_water) {
+		printf("the input was not memory mapped\n");
+		ret = 1;
+	}
+	nut_demuxer_uninit(nut);
+	fclose(f);
+	return ret;
+}
+
+static int test_frame_ref(void) {
+	// with complete reads, and with reads cut short and EAGAIN in between
+	FILE * f = mux(FRAMES, 0);
+	nut_demuxer_opts_tt dopts;
+	starve_tt in;
+	int ret;
+	demux_opts(f, &dopts);
+	ret = compare(f, &dopts, NULL, READ_FRAME_REF, "nut_read_frame_ref()");
+	starve_opts(f, &in, &dopts);
+	ret = ret || compare(f, &dopts, &in, READ_FRAME_REF, "nut_read_frame_ref() with EAGAIN");
+	fclose(f);
+	return ret;
+}
+
+static int test_short_reads(void) {
+	// nut_read_frame() continued after EAGAIN, for several ways of cutting the reads short
+	FILE * f = mux(FRAMES, 0);
+	int i, ret = 0;
+	for (i = 1; i <= 8 && !ret; i++) {
+		nut_demuxer_opts_tt dopts;
+		starve_tt in;
+		starve_opts(f, &in, &dopts);
+		in.seed = i;
+		ret = compare(f, &dopts, &in, READ_FRAME, "nut_read_frame() with EAGAIN");
+	}
+	fclose(f);
+	return ret;
+}
+
+static int test_read_ahead(void) {
+	static const struct { int min, align, max; } t[] = {
+		{ 65536, 0, 0 }, { 4096, 4096, 1024*1024 }, { 1000, 3000, 0 }, { 0, 512, 0 }, { 0, 0, 256*1024 },
+	};
+	FILE * f = mux(FRAMES, 0);
+	int i, ret = 0;
+	for (i = 0; i < sizeof t / sizeof t[0] && !ret; i++) {
+		nut_demuxer_opts_tt dopts;
+		watch_tt w;
+		watch_opts(f, &w, &dopts);
+		dopts.read_ahead = t[i].min;
+		dopts.read_ahead_align = t[i].align;
+		dopts.read_ahead_max = t[i].max;
+		w.align = t[i].align;
+		w.min = t[i].min;
+		ret = compare(f, &dopts, NULL, READ_FRAME, "read-ahead");
+		if (w.bad) {
+			printf("%d of %d reads were short or misaligned\n", w.bad, w.reads);
+			ret = 1;
+		}
+		if (ret) printf("with read_ahead %d, read_ahead_align %d, read_ahead_max %d\n", t[i].min, t[i].align, t[i].max);
+	}
+	fclose(f);
+	return ret;
+}
+
+static int test_prefetch(void) {
+	static const int sizes[] = { 4096, 65536, 1024*1024 };
+	FILE * f = mux(FRAMES, 0);
+	int i, ret = 0;
+	for (i = 0; i < sizeof sizes / sizeof sizes[0] && !ret; i++) {
+		nut_demuxer_opts_tt dopts;
+		starve_tt in;
+		demux_opts(f, &dopts);
+		dopts.prefetch = sizes[i];
+		ret = compare(f, &dopts, NULL, READ_FRAME_REF, "prefetch");
+		if (!ret) {
+			starve_opts(f, &in, &dopts);
+			dopts.prefetch = sizes[i];
+			ret = compare(f, &dopts, &in, READ_FRAME, "prefetch with EAGAIN");
+		}
+		if (ret) printf("with blocks of %d bytes\n", sizes[i]);
+	}
+	fclose(f);
+	return ret;
+}
+
+static int test_hint(void) {
+	// seeks in a file without an index announce the areas they read
+	FILE * f = mux(FRAMES, 0);
+	nut_demuxer_opts_tt dopts;
+	watch_tt w;
+	int ret;
+	watch_opts(f, &w, &dopts);
+	dopts.input.hint = watch_hint;
+	fseeko(f, 0, SEEK_END);
+	w.size = ftello(f);
+	ret = compare(f, &dopts, NULL, READ_FRAME, "a stream with hints");
+	if (!ret && (!w.hints || w.bad_hints)) {
+		printf("%d hints, %d of them outside the file\n", w.hints, w.bad_hints);
+		ret = 1;
+	}
+	fclose(f);
+	return ret;
+}
+
+static int test_read_packets(void) {
+	// from a buffered, a starved and a memory mapped input
+	FILE * f = mux(FRAMES, 0);
+	nut_demuxer_opts_tt dopts;
+	starve_tt in;
+	int ret;
+	demux_opts(f, &dopts);
+	ret = compare(f, &dopts, NULL, READ_PACKETS, "nut_read_packets()");
+	starve_opts(f, &in, &dopts);
+	ret = ret || compare(f, &dopts, &in, READ_PACKETS, "nut_read_packets() with EAGAIN");
+	demux_opts(f, &dopts);
+	dopts.mmap_input = 1;
+	ret = ret || compare(f, &dopts, NULL, READ_PACKETS, "nut_read_packets() from memory mapped input");
+	fclose(f);
+	return ret;
+}
+
+static int test_stats(void) {
+	// playing a file counts the frames and syncpoints the muxer wrote
+	FILE * f = mux(FRAMES, 0);
+	nut_demuxer_opts_tt dopts;
+	nut_context_tt * nut;
+	nut_stats_tt m, d;
+	uint32_t sum;
+	int i, ret = 0;
+	mux_stats(&m);
+	demux_opts(f, &dopts);
+	nut = demux_init(&dopts);
+	if (play(nut, READ_FRAME, 0, &sum) != FRAMES || m.streams[0].frames + m.streams[1].frames + m.streams[2].frames != FRAMES) {
+		printf("the muxer did not count %d frames\n", FRAMES);
+		ret = 1;
+	}
+	nut_get_stats(nut, &d);
+	if (d.syncpoints != m.syncpoints || d.syncpoint_bytes != m.syncpoint_bytes) {
+		printf("%"PRIu64" syncpoints of %"PRIu64" bytes, %"PRIu64" of %"PRIu64" bytes muxed\n", d.syncpoints, d.syncpoint_bytes, m.syncpoints, m.syncpoint_bytes);
+		ret = 1;
+	}
+	for (i = 0; i < 3 && !ret; i++) {
+		if (!memcmp(&d.streams[i], &m.streams[i], sizeof(nut_stream_stats_tt))) continue;
+		printf("stream %d: %"PRIu64" frames, %"PRIu64" bytes, %"PRIu64" header bytes, %"PRIu64" with checksum, %"PRIu64" coded\n",
+		       i, d.streams[i].frames, d.streams[i].bytes, d.streams[i].header_bytes, d.streams[i].checksum_frames, d.streams[i].coded_frames);
+		printf("muxed:    %"PRIu64" frames, %"PRIu64" bytes, %"PRIu64" header bytes, %"PRIu64" with checksum, %"PRIu64" coded\n",
+		       m.streams[i].frames, m.streams[i].bytes, m.streams[i].header_bytes, m.streams[i].checksum_frames, m.streams[i].coded_frames);
+		ret = 1;
+	}
+	nut_demuxer_uninit(nut);
+	fclose(f);
+	return ret;
+}
+
+static int test_frame_codes(void) {
+	// frames taken straight from the generated framecode table, and the
+	// same frames with every field coded in the frame header
+	static nut_frame_table_input_tt coded[] = {
+		{ 8192, 0, 0, 1, 0, 1 },     // FLAG_INVALID
+		{ 4096, 1, 0, 1, 0, 1 },     // FLAG_CODED
+		{ 8192, 0, 0, 253, 0, 253 },
+		{ -1 },
+	};
+	FILE * f = mux(FRAMES, 0), * g = mux_fti(FRAMES, coded);
+	uint32_t a, b;
+	int ret = reference(f, &a);
+	if (!ret && !(ret = reference(g, &b)) && a != b) {
+		printf("frames with coded fields differ\n");
+		ret = 1;
+	}
+	fseek(f, 0, SEEK_END);
+	fseek(g, 0, SEEK_END);
+	if (!ret && ftell(g) <= ftell(f)) {
+		printf("coding every field did not make the file bigger\n");
+		ret = 1;
+	}
+	fclose(f);
+	fclose(g);
+	return ret;
+}
+
+// a file with pts, sizes and info values of every VLC length
+#define VLC_FRAMES 2000
+
+static const int64_t vlc_values[] = {
+	0, 1, 63, 64, 127, 128, 8191, 8192, 16383, 16384, 1LL << 31, (1LL << 35) + 5, 1LL << 56, (1LL << 62) - 1,
+};
+enum { VLC_VALUES = sizeof vlc_values / sizeof vlc_values[0] };
+
+static void vlc_frame(int i, nut_packet_tt * p) {
+	// a ns and a 1/48000 stream at the same time, with jumps of up to about 18 hours
+	uint64_t t = (1ULL << 45) + i * 20000000ULL + (uint64_t)(i / 10) * (1ULL << 36) + (i % 7) * 999;
+	memset(p, 0, sizeof *p);
+	p->stream = i & 1;
+	p->pts = p->stream ? t / 1000 * 48 / 1000 : t;
+	p->flags = NUT_FLAG_KEY;
+	p->len = vlc_values[i % VLC_VALUES] % 100003;
+}
+
+static FILE * mux_vlc(void) {
+	FILE * f = tmpfile();
+	nut_muxer_opts_tt mo;
+	nut_stream_header_tt s[3];
+	nut_info_field_tt fields[2 * VLC_VALUES];
+	nut_info_packet_tt info[2];
+	nut_context_tt * nut;
+	uint8_t * buf = calloc(100003, 1);
+	int i;
+
+	if (!f || !buf) exit(1);
+	memset(&mo, 0, sizeof mo);
+	mo.output.priv = f;
+	mo.write_index = 1;
+	mo.max_distance = 32768;
+	memset(s, 0, sizeof s);
+	s[0].type = NUT_VIDEO_CLASS; s[0].fourcc = (uint8_t *)"mp4v"; s[0].fourcc_len = 4;
+	s[0].time_base.num = 1; s[0].time_base.den = 1000000000;
+	s[0].width = 16384; s[0].height = 8191; s[0].sample_width = 1; s[0].sample_height = 1;
+	s[1].type = NUT_AUDIO_CLASS; s[1].fourcc = (uint8_t *)"pcm "; s[1].fourcc_len = 4;
+	s[1].time_base.num = 1; s[1].time_base.den = 48000; s[1].fixed_fps = 1;
+	s[1].samplerate_num = 48000; s[1].samplerate_denom = 1; s[1].channel_count = 128;
+	s[2].type = -1;
+	memset(fields, 0, sizeof fields);
+	for (i = 0; i < VLC_VALUES; i++) {
+		sprintf(fields[i].name, "v%d", i);
+		strcpy(fields[i].type, "v");
+		fields[i].val = vlc_values[i];
+		sprintf(fields[i + VLC_VALUES].name, "s%d", i);
+		strcpy(fields[i + VLC_VALUES].type, "s");
+		fields[i + VLC_VALUES].val = -vlc_values[i];
+	}
+	memset(info, 0, sizeof info);
+	info[0].count = 2 * VLC_VALUES;
+	info[0].chapter_tb = s[0].time_base;
+	info[0].fields = fields;
+	info[1].count = -1;
+
+	nut = nut_muxer_init(&mo, s, info);
+	for (i = 0; i < VLC_FRAMES; i++) {
+		nut_packet_tt p;
+		vlc_frame(i, &p);
+		nut_write_frame(nut, &p, buf);
+	}
+	nut_muxer_uninit(nut);
+	free(buf);
+	return f;
+}
+
+static int check_vlc(nut_demuxer_opts_tt * dopts, starve_tt * in) {
+	nut_context_tt * nut = nut_demuxer_init(dopts);
+	nut_stream_header_tt * s;
+	nut_info_packet_tt * info;
+	nut_packet_tt p, q;
+	const uint8_t * buf;
+	int i, err;
+
+	while ((err = nut_read_headers(nut, &s, &info)) == NUT_ERR_EAGAIN);
+	if (err) goto err_out;
+	if (s[0].width != 16384 || s[0].height != 8191 || s[1].channel_count != 128 || info[0].count != 2 * VLC_VALUES) {
+		printf("headers differ\n");
+		err = -1;
+		goto err_out;
+	}
+	for (i = 0; i < 2 * VLC_VALUES; i++) {
+		int64_t val = i < VLC_VALUES ? vlc_values[i] : -vlc_values[i - VLC_VALUES];
+		if (info[0].fields[i].val == val) continue;
+		printf("info field %s: %"PRId64" instead of %"PRId64"\n", info[0].fields[i].name, info[0].fields[i].val, val);
+		err = -1;
+		goto err_out;
+	}
+	if (in) in->on = 1;
+	for (i = 0; i < VLC_FRAMES; i++) {
+		while ((err = nut_read_next_packet(nut, &p)) == NUT_ERR_EAGAIN);
+		if (err) goto err_out;
+		while ((err = nut_read_frame_ref(nut, p.len, &buf)) == NUT_ERR_EAGAIN);
+		if (err) goto err_out;
+		vlc_frame(i, &q);
+		if (p.stream != q.stream || p.pts != q.pts || p.len != q.len || p.flags != q.flags) {
+			printf("frame %d: stream %d pts %"PRIu64" len %d, written as stream %d pts %"PRIu64" len %d\n", i, p.stream, p.pts, p.len, q.stream, q.pts, q.len);
+			err = -1;
+			goto err_out;
+		}
+	}
+	while ((err = nut_read_next_packet(nut, &p)) == NUT_ERR_EAGAIN);
+	if (err != NUT_ERR_EOF) {
+		printf("no EOF after the last frame: %s\n", nut_error(err));
+		err = -1;
+	} else err = 0;
+err_out:
+	if (err > 0) printf("%s\n", nut_error(err));
+	nut_demuxer_uninit(nut);
+	return err != 0;
+}
+
+static int test_vlc(void) {
+	// values of every length, whole and split between reads
+	FILE * f = mux_vlc();
+	nut_demuxer_opts_tt dopts;
+	starve_tt in;
+	int i, ret;
+	demux_opts(f, &dopts);
+	ret = check_vlc(&dopts, NULL);
+	for (i = 1; i <= 8 && !ret; i++) {
+		starve_opts(f, &in, &dopts);
+		in.seed = i;
+		ret = check_vlc(&dopts, &in);
+	}
+	fclose(f);
+	return ret;
+}
+
+int main(void) {
+	static const test_tt tests[] = {
+		{ "mmap", test_mmap },
+		{ "frame_ref", test_frame_ref },
+		{ "short_reads", test_short_reads },
+		{ "read_ahead", test_read_ahead },
+		{ "prefetch", test_prefetch },
+		{ "hint", test_hint },
+		{ "read_packets", test_read_packets },
+		{ "stats", test_stats },
+		{ "frame_codes", test_frame_codes },
+		{ "vlc", test_vlc },
+	};
+	return run_tests(tests, sizeof tests / sizeof tests[0]);
+}
@@ -0,0 +1,422 @@
+// (C) 2026 agent
+// This file is available under the MIT/X license, see COPYING
+
+#include "common.h"
+
+// Seeking regression tests.
+
+static nut_context_tt * demux(FILE * f, int read_index) {
+	nut_demuxer_opts_tt dopts;
+	demux_opts(f, &dopts);
+	dopts.read_index = read_index;
+	return demux_init(&dopts);
+}
+
+static int test_unread_index(void) {
+	// Index entries have no pts until their syncpoint is read. Seeking to
+	// the start after the end was read must still find syncpoints there.
+	static const struct { double pos; int flags; } t[] = { { 0.13, 2 }, { 0.17, 0 }, { 0.13, 2 }, { 0.07, 0 } };
+	FILE * f = mux(12000, 1);
+	nut_context_tt * nut = demux(f, 1);
+	nut_packet_tt p;
+	int i, err, ret = 0;
+
+	for (i = 0; i < sizeof t / sizeof t[0] && !ret; i++) {
+		if ((err = nut_seek(nut, 100, 0, NULL))) {
+			printf("seek to 100s: %s\n", nut_error(err));
+			ret = 1;
+		} else if ((err = nut_seek(nut, t[i].pos, t[i].flags, NULL)) || (err = first_packet(nut, 1, &p))) {
+			printf("seek to %.3f flags %d: %s\n", t[i].pos, t[i].flags, nut_error(err));
+			ret = 1;
+		} else if (!(t[i].flags & 2) && AUDIO_TB(p.pts) > t[i].pos) {
+			printf("seek to %.3f flags %d landed at audio pts %"PRIu64"\n", t[i].pos, t[i].flags, p.pts);
+			ret = 1;
+		}
+	}
+	nut_demuxer_uninit(nut);
+	fclose(f);
+	return ret;
+}
+
+static int test_exact_pts(void) {
+	// Backward seeks to the pts of a keyframe land on that keyframe, with
+	// or without an index and whatever the syncpoint cache holds.
+	static const struct { int stream; uint64_t pts; } t[] = {
+		{ 0, 4800 }, { 1, 3392 }, { 0, 2400 }, { 1, 3391 }, { 0, 96 }, { 1, 7 }, { 0, 4800 }, { 1, 3392 },
+	};
+	FILE * f = mux(12000, 1);
+	int i, j, err, ret = 0;
+
+	for (i = 0; i < 2; i++) {
+		nut_context_tt * nut = demux(f, i);
+		for (j = 0; j < sizeof t / sizeof t[0] && !ret; j++) {
+			int active[2] = { t[j].stream, -1 };
+			nut_packet_tt p;
+			if ((err = nut_seek_pts(nut, t[j].stream, t[j].pts, 0, active)) || (err = first_packet(nut, t[j].stream, &p))) {
+				printf("seek to stream %d pts %"PRIu64" with read_index %d: %s\n", t[j].stream, t[j].pts, i, nut_error(err));
+				ret = 1;
+			} else if (p.pts != t[j].pts) {
+				printf("seek to stream %d pts %"PRIu64" with read_index %d landed at %"PRIu64"\n", t[j].stream, t[j].pts, i, p.pts);
+				ret = 1;
+			}
+		}
+		nut_demuxer_uninit(nut);
+	}
+	fclose(f);
+	return ret;
+}
+
+// seeks to stream 0 pts 4800, then by delta video ticks, relative in pts or in seconds
+static int seek_relative(FILE * f, int read_index, int in_pts, int64_t delta, uint64_t * key, uint32_t * sum) {
+	nut_context_tt * nut = demux(f, read_index);
+	int active[2] = { 0, -1 };
+	nut_packet_tt p;
+	int err;
+	if ((err = nut_seek_pts(nut, 0, 4800, 0, active)) || (err = first_packet(nut, 0, &p)) ||
+	    (err = in_pts ? nut_seek_pts(nut, 0, delta, 1, active) : nut_seek(nut, delta * 1001 / 30000., 1, active)) ||
+	    (err = first_packet(nut, 0, &p))) {
+		printf("relative seek by %"PRId64" %s with read_index %d: %s\n", delta, in_pts ? "ticks" : "seconds", read_index, nut_error(err));
+		nut_demuxer_uninit(nut);
+		return 1;
+	}
+	*key = p.pts;
+	*sum = 2166136261u;
+	err = play(nut, READ_FRAME, 100, sum) != 100;
+	nut_demuxer_uninit(nut);
+	return err;
+}
+
+static int test_pts_flags(void) {
+	// relative and forward seeks by pts, and seeks in streams that do not exist
+	FILE * f = mux(12000, 1);
+	int i, err, ret = 0;
+
+	for (i = 0; i < 2 && !ret; i++) {
+		nut_context_tt * nut;
+		int active[2] = { 0, -1 };
+		nut_packet_tt p;
+		uint64_t key[2];
+		uint32_t sum[2];
+		if ((ret = seek_relative(f, i, 1, -2400, &key[0], &sum[0]) || seek_relative(f, i, 0, -2400, &key[1], &sum[1]))) break;
+		if (key[0] % 48 || key[0] > 2400 || key[0] < 2400 - 2 * 48 || key[0] != key[1] || sum[0] != sum[1]) {
+			printf("relative seek with read_index %d landed at %"PRIu64" in pts and %"PRIu64" in seconds\n", i, key[0], key[1]);
+			ret = 1;
+			break;
+		}
+		nut = demux(f, i);
+		if ((err = nut_seek_pts(nut, 0, 2401, 2, active)) || (err = first_packet(nut, 0, &p))) {
+			printf("forward seek with read_index %d: %s\n", i, nut_error(err));
+			ret = 1;
+		} else if (p.pts < 2401 || p.pts > 2448 || !(p.flags & NUT_FLAG_KEY)) {
+			printf("forward seek to 2401 with read_index %d landed at %"PRIu64"\n", i, p.pts);
+			ret = 1;
+		}
+		if (!ret && ((err = nut_seek_pts(nut, 3, 0, 0, NULL)) != NUT_ERR_GENERAL_ERROR ||
+		             (err = nut_seek_pts(nut, -1, 0, 0, NULL)) != NUT_ERR_GENERAL_ERROR)) {
+			printf("seek in a stream that does not exist: %s\n", nut_error(err));
+			ret = 1;
+		}
+		nut_demuxer_uninit(nut);
+	}
+	fclose(f);
+	return ret;
+}
+
+static int test_batch_index(void) {
+	// nut_seek_batch() gives the same keyframes whether the index was read or not
+	static const uint64_t pts[] = { 0, 3, 700, 2000, 2001, 4000, 5100, 100000 };
+	enum { n = sizeof pts / sizeof pts[0] };
+	nut_keyframe_tt res[2][n];
+	FILE * f = mux(12000, 1);
+	int i, err, ret = 0;
+
+	for (i = 0; i < 2; i++) {
+		nut_context_tt * nut = demux(f, i);
+		if ((err = nut_seek(nut, 100, 0, NULL)) || (err = nut_seek_batch(nut, 0, pts, n, res[i]))) {
+			printf("batch with read_index %d: %s\n", i, nut_error(err));
+			ret = 1;
+		}
+		nut_demuxer_uninit(nut);
+	}
+	for (i = 0; i < n && !ret; i++) {
+		if (res[0][i].pd.pts == res[1][i].pd.pts && res[0][i].syncpoint == res[1][i].syncpoint) continue;
+		printf("batch target %"PRIu64": %"PRIu64" without index, %"PRIu64" with it\n", pts[i], res[0][i].pd.pts, res[1][i].pd.pts);
+		ret = 1;
+	}
+	fclose(f);
+	return ret;
+}
+
+static int test_batch_eor(void) {
+	// On a sparse stream with EOR frames, every target of a batch gets the
+	// keyframe it gets in a batch of its own
+	enum { n = 175 };
+	uint64_t pts[n];
+	nut_keyframe_tt res[n], one;
+	FILE * f = mux(12000, 1);
+	nut_context_tt * nut = demux(f, 1);
+	int i, err, eor = 0, ret = 0;
+
+	for (i = 0; i < n; i++) pts[i] = 413 + 1000 * i; // ms, the file is 175s long
+	if ((err = nut_seek_batch(nut, 2, pts, n, res))) {
+		printf("batch: %s\n", nut_error(err));
+		ret = 1;
+	}
+	for (i = 0; i < n && !ret; i++) {
+		if ((err = nut_seek_batch(nut, 2, &pts[i], 1, &one))) {
+			printf("target %"PRIu64" alone: %s\n", pts[i], nut_error(err));
+			ret = 1;
+		} else if (one.pd.pts != res[i].pd.pts || one.syncpoint != res[i].syncpoint) {
+			printf("target %"PRIu64": %"PRIu64" alone, %"PRIu64" in the batch\n", pts[i], one.pd.pts, res[i].pd.pts);
+			ret = 1;
+		}
+		eor += !!(res[i].pd.flags & NUT_FLAG_EOR);
+	}
+	if (eor) {
+		printf("%d EOR frames given as keyframes\n", eor);
+		ret = 1;
+	}
+	nut_demuxer_uninit(nut);
+	fclose(f);
+	return ret;
+}
+
+static int test_seek_eagain(void) {
+	// seeks repeated after EAGAIN land where they do with complete reads,
+	// for many ways of cutting the reads short
+	static const struct { double pos; int flags; } t[] = {
+		{ 100, 0 }, { 25.7, 0 }, { 150.2, 2 }, { 3, 2 }, { 88.6, 0 }, { 10, 1 }, { -50, 1 }, { 170, 0 }, { 33.3, 2 }, { 1, 2 },
+	};
+	enum { n = sizeof t / sizeof t[0] };
+	nut_packet_tt res[n], p;
+	FILE * f = mux(12000, 0);
+	int i, j, err, ret = 0;
+
+	for (i = 0; i <= 32 && !ret; i++) {
+		nut_demuxer_opts_tt dopts;
+		nut_context_tt * nut;
+		starve_tt in;
+		starve_opts(f, &in, &dopts);
+		nut = demux_init(&dopts);
+		in.on = !!i;
+		in.seed = i;
+		for (j = 0; j < n && !ret; j++) {
+			while ((err = nut_seek(nut, t[j].pos, t[j].flags, NULL)) == NUT_ERR_EAGAIN);
+			if (!err) err = first_packet(nut, 1, i ? &p : &res[j]);
+			if (err) {
+				printf("seek to %.3f flags %d with seed %d: %s\n", t[j].pos, t[j].flags, i, nut_error(err));
+				ret = 1;
+			} else if (i && p.pts != res[j].pts) {
+				printf("seek to %.3f flags %d: audio pts %"PRIu64", %"PRIu64" with seed %d\n", t[j].pos, t[j].flags, res[j].pts, p.pts, i);
+				ret = 1;
+			}
+		}
+		if (i && !in.eagain) {
+			printf("no read was cut short with seed %d\n", i);
+			ret = 1;
+		}
+		nut_demuxer_uninit(nut);
+	}
+	fclose(f);
+	return ret;
+}
+
+static int test_memory_limit(void) {
+	// a thinned syncpoint cache must not change where seeks land
+	static const struct { double pos; int flags, audio; } t[] = {
+		{ 150.2, 2, 0 }, { 102.768, 0, 0 }, { 10, 0, 1 }, { 70.5, 2, 1 }, { 120.33, 0, 0 },
+		{ 33.3, 2, 0 }, { 1, 2, 0 }, { 144.7, 0, 1 }, { 89.6, 2, 0 }, { 55.55, 0, 0 },
+	};
+	enum { n = sizeof t / sizeof t[0] };
+	static const int audio[] = { 1, -1 };
+	nut_packet_tt res[2][n];
+	FILE * f = mux(12000, 0);
+	int i, j, err, ret = 0;
+
+	for (i = 0; i < 2 && !ret; i++) {
+		nut_demuxer_opts_tt dopts;
+		nut_context_tt * nut;
+		nut_memory_tt m;
+		nut_packet_tt p;
+		demux_opts(f, &dopts);
+		dopts.memory_limit = i ? 60000 : 0;
+		nut = demux_init(&dopts);
+		first_packet(nut, -1, &p); // play to the end, filling the cache
+		for (j = 0; j < n && !ret; j++) {
+			if (!(err = nut_seek(nut, t[j].pos, t[j].flags, t[j].audio ? audio : NULL))) err = first_packet(nut, 1, &res[i][j]);
+			if (!err) continue;
+			printf("seek to %.3f flags %d with memory_limit %d: %s\n", t[j].pos, t[j].flags, i ? 60000 : 0, nut_error(err));
+			ret = 1;
+		}
+		nut_get_memory(nut, &m);
+		if (i && !m.thinned) {
+			printf("the syncpoint cache was not thinned\n");
+			ret = 1;
+		}
+		nut_demuxer_uninit(nut);
+	}
+	for (j = 0; j < n && !ret; j++) {
+		if (res[0][j].pts == res[1][j].pts) continue;
+		printf("seek to %.3f flags %d: audio pts %"PRIu64" without memory_limit, %"PRIu64" with it\n", t[j].pos, t[j].flags, res[0][j].pts, res[1][j].pts);
+		ret = 1;
+	}
+	fclose(f);
+	return ret;
+}
+
+static int test_ns_pts(void) {
+	// A nanosecond video timebase puts pts past 2^31 after about two seconds.
+	// They must be read back exactly, and seeks to keyframes must find them.
+	static const int64_t ticks = 33366667;
+	static const int key[] = { 100, 10, 64, 1, 100, 0 }; // every 48th video frame is a keyframe
+	nut_timebase_tt tb = { 1, 1000000000 };
+	FILE * f = mux_video_tb(12000, 1, tb, ticks);
+	nut_context_tt * nut = demux(f, 0);
+	nut_packet_tt p;
+	const uint8_t * buf;
+	int i, j, err, video = 0, ret = 0;
+
+	while (!(err = nut_read_next_packet(nut, &p)) && !(err = nut_read_frame_ref(nut, p.len, &buf))) {
+		if (p.stream || ret) continue;
+		if (p.pts % ticks || p.pts / ticks > 12000) {
+			printf("video frame %d has pts %"PRIu64"\n", video, p.pts);
+			ret = 1;
+		}
+		video++;
+	}
+	if (err != NUT_ERR_EOF || video < 48 * key[0]) {
+		printf("%d video frames: %s\n", video, nut_error(err));
+		ret = 1;
+	}
+	nut_demuxer_uninit(nut);
+
+	for (i = 0; i < 2 && !ret; i++) {
+		nut = demux(f, i);
+		for (j = 0; j < sizeof key / sizeof key[0] && !ret; j++) {
+			int active[2] = { 0, -1 };
+			int64_t pts = 48 * key[j] * ticks;
+			if ((err = nut_seek_pts(nut, 0, pts, 0, active)) || (err = first_packet(nut, 0, &p))) {
+				printf("seek to pts %"PRId64" with read_index %d: %s\n", pts, i, nut_error(err));
+				ret = 1;
+			} else if (p.pts != pts) {
+				printf("seek to pts %"PRId64" with read_index %d landed at %"PRIu64"\n", pts, i, p.pts);
+				ret = 1;
+			}
+		}
+		nut_demuxer_uninit(nut);
+	}
+	fclose(f);
+	return ret;
+}
+
+static int test_trace(void) {
+	// With the index, the area to search is known. Without it, a first
+	// seek bisects the file, and a second one to the same place needs no
+	// probes as the syncpoints around the target are cached.
+	FILE * f = mux(12000, 1);
+	int i, err, ret = 0;
+
+	for (i = 0; i < 2 && !ret; i++) {
+		nut_demuxer_opts_tt dopts;
+		nut_seek_trace_tt t;
+		nut_context_tt * nut;
+		int j;
+		demux_opts(f, &dopts);
+		dopts.read_index = i;
+		dopts.seek_trace = &t;
+		nut = demux_init(&dopts);
+		for (j = 0; j < 2 && !ret; j++) {
+			if ((err = nut_seek(nut, 100, 0, NULL))) {
+				printf("seek with read_index %d: %s\n", i, nut_error(err));
+				ret = 1;
+			} else if (i ? !t.used_index || t.probes : j ? t.probes : t.used_index || !t.probes || !t.bytes_read || !t.seeks) {
+				printf("seek %d with read_index %d: used_index %d, %d probes, %"PRId64" bytes read, %d input seeks\n",
+				       j, i, t.used_index, t.probes, (int64_t)t.bytes_read, t.seeks);
+				ret = 1;
+			}
+		}
+		nut_demuxer_uninit(nut);
+	}
+	fclose(f);
+	return ret;
+}
+
+// allocator that knows how many bytes are held
+static size_t held;
+
+static void * count_malloc(size_t size) {
+	size_t * p = malloc(size + 16);
+	if (!p) return NULL;
+	*p = size;
+	held += size;
+	return (uint8_t *)p + 16;
+}
+
+static void count_free(void * ptr) {
+	size_t * p = ptr ? (size_t *)((uint8_t *)ptr - 16) : NULL;
+	if (!p) return;
+	held -= *p;
+	free(p);
+}
+
+static void * count_realloc(void * ptr, size_t size) {
+	size_t * p = ptr ? (size_t *)((uint8_t *)ptr - 16) : NULL, old = p ? *p : 0;
+	if (!(p = realloc(p, size + 16))) return NULL;
+	*p = size;
+	held += size - old;
+	return (uint8_t *)p + 16;
+}
+
+static int test_memory_count(void) {
+	// nut_get_memory() accounts for all but some small fixed allocations
+	static const double t[] = { 100, 3, 170, 60 };
+	FILE * f = mux(12000, 1);
+	int i, j, err, ret = 0;
+
+	for (i = 0; i < 2 && !ret; i++) {
+		nut_demuxer_opts_tt dopts;
+		nut_context_tt * nut;
+		nut_memory_tt m;
+		nut_packet_tt p;
+		demux_opts(f, &dopts);
+		dopts.read_index = i;
+		dopts.alloc = (nut_alloc_tt){ count_malloc, count_realloc, count_free };
+		held = 0;
+		nut = demux_init(&dopts);
+		for (j = 0; j <= sizeof t / sizeof t[0] && !ret; j++) {
+			if (!j) err = first_packet(nut, -1, &p) == NUT_ERR_EOF ? 0 : NUT_ERR_GENERAL_ERROR;
+			else if (!(err = nut_seek(nut, t[j-1], 0, NULL))) err = first_packet(nut, 0, &p);
+			nut_get_memory(nut, &m);
+			if (err) {
+				printf("step %d with read_index %d: %s\n", j, i, nut_error(err));
+				ret = 1;
+			} else if (m.total > held || held - m.total > 8*1024) {
+				printf("step %d with read_index %d: %d bytes counted, %d held\n", j, i, (int)m.total, (int)held);
+				ret = 1;
+			}
+		}
+		nut_demuxer_uninit(nut);
+		if (held) {
+			printf("%d bytes left after nut_demuxer_uninit()\n", (int)held);
+			ret = 1;
+		}
+	}
+	fclose(f);
+	return ret;
+}
+
+int main(void) {
+	static const test_tt tests[] = {
+		{ "unread_index", test_unread_index },
+		{ "exact_pts", test_exact_pts },
+		{ "pts_flags", test_pts_flags },
+		{ "batch_index", test_batch_index },
+		{ "batch_eor", test_batch_eor },
+		{ "seek_eagain", test_seek_eagain },
+		{ "memory_limit", test_memory_limit },
+		{ "ns_pts", test_ns_pts },
+		{ "trace", test_trace },
+		{ "memory_count", test_memory_count },
+	};
+	return run_tests(tests, sizeof tests / sizeof tests[0]);
+}
@@ -0,0 +1,144 @@
+// (C) 2026 agent
+// This file is available under the MIT/X license, see COPYING
+
+#include <unistd.h>
+#include <pthread.h>
+#include "common.h"
+
+// nut_demuxer_init_shared() regression tests. Contexts sharing the headers
+// and index of one master, each used by its own thread, must give the same
+// frames as contexts of their own.
+
+#define FRAMES 12000
+#define THREADS 8
+
+static const double seek_to[] = { 100, 25.7, 170, 3, 0, 150.2, 60, 120.5 }; // the file is 175s long
+enum { SEEKS = sizeof seek_to / sizeof seek_to[0] };
+
+// input with a position of its own, the file descriptor is shared
+typedef struct {
+	int fd;
+	off_t pos;
+} pread_tt;
+
+static size_t pread_read(void * priv, size_t len, uint8_t * buf) {
+	pread_tt * in = priv;
+	ssize_t n = pread(in->fd, buf, len, in->pos);
+	if (n <= 0) return 0;
+	in->pos += n;
+	return n;
+}
+
+static off_t pread_seek(void * priv, long long pos, int whence) {
+	pread_tt * in = priv;
+	if (whence == SEEK_CUR) pos += in->pos;
+	else if (whence == SEEK_END) pos += lseek(in->fd, 0, SEEK_END);
+	return in->pos = pos;
+}
+
+static void pread_opts(int fd, pread_tt * in, nut_demuxer_opts_tt * dopts) {
+	memset(dopts, 0, sizeof *dopts);
+	in->fd = fd;
+	in->pos = 0;
+	dopts->input.priv = in;
+	dopts->input.read = pread_read;
+	dopts->input.seek = pread_seek;
+	dopts->cache_syncpoints = 1;
+}
+
+typedef struct {
+	nut_context_tt * nut;
+	int first;              // first seek, the others follow in order
+	uint32_t sum[SEEKS + 1]; // of the whole file, then of the frames after each seek
+	int err;
+} reader_tt;
+
+// plays the file, then reads some frames after each seek
+static void * reader(void * priv) {
+	reader_tt * r = priv;
+	nut_stream_header_tt * s;
+	int i, err;
+	if ((err = nut_read_headers(r->nut, &s, NULL))) {
+		printf("headers: %s\n", nut_error(err));
+		r->err = 1;
+		return NULL;
+	}
+	r->sum[0] = 2166136261u;
+	if (play(r->nut, READ_FRAME_REF, 0, &r->sum[0]) != FRAMES) {
+		printf("could not play %d frames\n", FRAMES);
+		r->err = 1;
+	}
+	for (i = 0; i < SEEKS && !r->err; i++) {
+		int j = (r->first + i) % SEEKS;
+		r->sum[j + 1] = 2166136261u;
+		if ((err = nut_seek(r->nut, seek_to[j], 0, NULL))) {
+			printf("seek to %.1f: %s\n", seek_to[j], nut_error(err));
+			r->err = 1;
+		} else if (play(r->nut, READ_FRAME_REF, 200, &r->sum[j + 1]) != 200) {
+			printf("could not read 200 frames after seeking to %.1f\n", seek_to[j]);
+			r->err = 1;
+		}
+	}
+	return NULL;
+}
+
+static int test_threads(int read_index) {
+	FILE * f = mux(FRAMES, 1);
+	int fd = fileno(f), i, ret = 0;
+	nut_demuxer_opts_tt dopts;
+	nut_stream_header_tt * s;
+	nut_context_tt * master;
+	pread_tt in[THREADS + 1];
+	reader_tt ref, r[THREADS];
+	pthread_t thread[THREADS];
+
+	fflush(f);
+	pread_opts(fd, &in[THREADS], &dopts);
+	ref.nut = demux_init(&dopts);
+	ref.first = 0;
+	ref.err = 0;
+	reader(&ref);
+	nut_demuxer_uninit(ref.nut);
+
+	pread_opts(fd, &in[THREADS], &dopts);
+	dopts.read_index = read_index;
+	master = demux_init(&dopts);
+	if (ref.err || nut_read_headers(master, &s, NULL)) ret = 1;
+	for (i = 0; i < THREADS && !ret; i++) {
+		pread_opts(fd, &in[i], &dopts);
+		memset(&r[i], 0, sizeof r[i]);
+		r[i].first = i % SEEKS;
+		if (!(r[i].nut = nut_demuxer_init_shared(&dopts, master))) exit(1);
+	}
+	for (i = 0; i < THREADS && !ret; i++) if (pthread_create(&thread[i], NULL, reader, &r[i])) exit(1);
+	for (i = 0; i < THREADS && !ret; i++) pthread_join(thread[i], NULL);
+	nut_demuxer_uninit(master); // the others still share what it read
+	for (i = 0; i < THREADS && !ret; i++) {
+		ret = r[i].err;
+		if (!ret && memcmp(r[i].sum, ref.sum, sizeof ref.sum)) {
+			printf("thread %d gives other frames than a context of its own\n", i);
+			ret = 1;
+		}
+		nut_demuxer_uninit(r[i].nut);
+	}
+	if (ret) printf("with read_index %d\n", read_index);
+	fclose(f);
+	return ret;
+}
+
+static int test_index(void) {
+	return test_threads(1);
+}
+
+static int test_no_index(void) {
+	// every thread finds syncpoints the shared cache does not know about
+	return test_threads(0);
+}
+
+int main(void) {
+	static const test_tt tests[] = {
+		{ "index", test_index },
+		{ "no_index", test_no_index },
+	};
+	return run_tests(tests, sizeof tests / sizeof tests[0]);
+}